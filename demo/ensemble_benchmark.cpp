@@ -0,0 +1,111 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compares the ways of scoring a boosted ensemble of decision stumps:
+//   BoostedClassifier                  one virtual call per weak learner
+//   BoostedEnsemble<ThresholdLearner>  stumps stored by value, classify inlined
+//   StumpEnsemble                      flat arrays, one stump at a time over blocks of samples
+//
+//   bazel run -c opt //:lakeml-ensemble-benchmark -- [nsamples] [nstumps]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "src/boosted_classifier.h"
+#include "src/boosted_ensemble.h"
+#include "src/dataset.h"
+#include "src/stump_ensemble.h"
+#include "src/threshold_learner.h"
+
+// Runs 'score' (which writes the responses of all samples) a few times, returning the best time
+// per sample and per stump in nanoseconds, and the sum of the responses
+template <class Score>
+static double Time(Score score, size_t nsamples, size_t nstumps, double *out_sum) {
+    std::vector<double> responses(nsamples);
+    double best = 1e300;
+
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::steady_clock::now();
+        score(responses.data());
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+            best = elapsed.count();
+    }
+
+    *out_sum = 0.0;
+    for (size_t i = 0; i < nsamples; i++)
+        *out_sum += responses[i];
+    return best / (nsamples * nstumps);
+}
+
+int main(int argc, char **argv) {
+    size_t nsamples = (argc > 1) ? std::atoi(argv[1]) : 100000;
+    int nstumps = (argc > 2) ? std::atoi(argv[2]) : 200;
+    const size_t dim = 16;
+
+    Dataset dataset;
+    dataset.reserve(nsamples);
+    for (size_t i = 0; i < nsamples; i++) {
+        DataInstance sample(dim);
+        for (size_t d = 0; d < dim; d++)
+            sample[d] = std::sin(0.37 * i * (d + 1)) + 0.01 * ((i * (d + 5)) % 17);
+        dataset.add(sample, (sample[0] + sample[3] - 0.5 * sample[7] > 0.2) ? 1 : -1);
+    }
+
+    std::cout << "Training " << nstumps << " stumps on " << nsamples << " samples..." << std::endl;
+    std::vector<double> weights(nsamples, 1.0);
+    BoostedClassifier boosted(nstumps);
+    boosted.train(dataset, weights);
+
+    BoostedEnsemble<ThresholdLearner> ensemble(boosted);
+    StumpEnsemble compiled(boosted);
+    Dataset columns(dataset, Dataset::COLUMN_MAJOR);
+
+    double sum_virtual, sum_template, sum_compiled;
+    double ns_virtual = Time([&](double *out) {
+        for (size_t i = 0; i < nsamples; i++)
+            out[i] = boosted.response(dataset[i]);
+    }, nsamples, nstumps, &sum_virtual);
+    double ns_template = Time([&](double *out) {
+        ensemble.response(dataset, 0, nsamples, out);
+    }, nsamples, nstumps, &sum_template);
+    double ns_compiled = Time([&](double *out) {
+        compiled.response(columns, 0, nsamples, out);
+    }, nsamples, nstumps, &sum_compiled);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "ns per sample and stump:" << std::endl;
+    std::cout << "  BoostedClassifier (virtual)          " << ns_virtual << std::endl;
+    std::cout << "  BoostedEnsemble<ThresholdLearner>    " << ns_template
+              << "  (x" << std::setprecision(2) << ns_virtual / ns_template << ")" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "  StumpEnsemble (column-major blocks)  " << ns_compiled
+              << "  (x" << std::setprecision(2) << ns_virtual / ns_compiled << ")" << std::endl;
+
+    if (sum_template != sum_virtual || sum_compiled != sum_virtual) {
+        std::cerr << "Error: the responses differ" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -24,6 +24,14 @@ public:
         return new ThresholdLearner(feature);
     }
 
+    // losing candidates are redrawn in place instead of reallocated
+    Classifier *recycleRandomInstance(Classifier *recycled) const override {
+        int feature = next_feature_;
+        next_feature_ = (next_feature_ + 1) % num_features_;
+        *static_cast<ThresholdLearner *>(recycled) = ThresholdLearner(feature);
+        return recycled;
+    }
+
 private:
     int num_features_;
     mutable int next_feature_;
@@ -83,9 +91,8 @@ int main(int argc, char **argv) {
     // Build binary dataset: setosa = -1, versicolor/virginica = 1
     Dataset binary_dataset;
     for (size_t i = 0; i < dataset.size(); ++i) {
-        DataInstance sample = dataset[i];
         int label = (dataset.getLabelAt(i) == 0) ? -1 : 1;
-        binary_dataset.add(sample, label);
+        binary_dataset.add(dataset[i], label);
     }
 
     const int num_features = static_cast<int>(dataset[0].size());
@@ -0,0 +1,165 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "binary_dataset.h"
+#include "csv_loader.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+namespace
+{
+
+const char BINARY_DATASET_MAGIC[8] = {'L', 'A', 'K', 'E', 'M', 'L', 'D', 'S'};
+const uint64_t SECTION_ALIGNMENT = 64;
+
+struct BinaryDatasetHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t nsamples;
+    uint64_t dim;
+    uint64_t values_offset;
+    uint64_t labels_offset;
+    uint64_t weights_offset;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(BinaryDatasetHeader) == 64, "binary dataset header must be 64 bytes");
+static_assert(sizeof(int) == sizeof(int32_t), "labels are stored as int32");
+
+uint64_t alignSection(uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// true if 'count' elements of 'element_size' bytes at 'offset' are within 'file_size' bytes,
+// without overflowing
+bool sectionFits(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size)
+{
+    return offset <= file_size && count <= (file_size - offset) / element_size;
+}
+
+void padTo(ofstream & file, uint64_t offset)
+{
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    uint64_t pos = file.tellp();
+    file.write(zeros, offset - pos);
+}
+
+}
+
+void SaveBinaryDataset(const Dataset & dataset, const string & filename, const vector<double> * weights)
+{
+    assert(weights == nullptr || weights->size() == dataset.size());
+
+    ofstream file(filename.c_str(), ios::binary | ios::trunc);
+    if (!file.is_open())
+        throw runtime_error("Cannot open file: " + filename);
+
+    BinaryDatasetHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_DATASET_MAGIC, sizeof(header.magic));
+    header.version = BINARY_DATASET_VERSION;
+    header.flags = (weights != nullptr) ? BINARY_DATASET_HAS_WEIGHTS : 0;
+    header.nsamples = dataset.size();
+    header.dim = dataset.dimension();
+    header.values_offset = alignSection(sizeof(header));
+    header.labels_offset = alignSection(header.values_offset + header.nsamples * header.dim * sizeof(double));
+    header.weights_offset = (weights != nullptr) ? alignSection(header.labels_offset + header.nsamples * sizeof(int32_t)) : 0;
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    padTo(file, header.values_offset);
+    vector<double> column_values(dataset.size());
+    for (size_t d = 0; d < dataset.dimension(); d++)
+    {
+        FeatureColumn column = dataset.column(d);
+        for (size_t i = 0; i < dataset.size(); i++)
+            column_values[i] = column[i];
+        file.write(reinterpret_cast<const char *>(column_values.data()), column_values.size() * sizeof(double));
+    }
+
+    padTo(file, header.labels_offset);
+    vector<int32_t> labels(dataset.size());
+    for (size_t i = 0; i < dataset.size(); i++)
+        labels[i] = dataset.getLabelAt(i);
+    file.write(reinterpret_cast<const char *>(labels.data()), labels.size() * sizeof(int32_t));
+
+    if (weights != nullptr)
+    {
+        padTo(file, header.weights_offset);
+        file.write(reinterpret_cast<const char *>(weights->data()), weights->size() * sizeof(double));
+    }
+
+    if (!file.good())
+        throw runtime_error("Cannot write file: " + filename);
+}
+
+Dataset LoadBinaryDataset(const string & filename, vector<double> * out_weights)
+{
+    shared_ptr<MappedFile> mapping(new MappedFile(filename));
+
+    BinaryDatasetHeader header;
+    if (mapping->size() < sizeof(header))
+        throw runtime_error("Not a binary dataset: " + filename);
+    memcpy(&header, mapping->data(), sizeof(header));
+
+    if (memcmp(header.magic, BINARY_DATASET_MAGIC, sizeof(header.magic)) != 0)
+        throw runtime_error("Not a binary dataset: " + filename);
+    if (header.version != BINARY_DATASET_VERSION)
+        throw runtime_error("Unsupported binary dataset version in: " + filename);
+
+    bool has_weights = (header.flags & BINARY_DATASET_HAS_WEIGHTS) != 0;
+    uint64_t file_size = mapping->size();
+
+    // the sizes are checked by division, as a corrupted header could make their products wrap
+    bool values_fit = header.nsamples == 0 ||
+                      (header.dim != 0 && header.values_offset <= file_size &&
+                       header.nsamples <= (file_size - header.values_offset) / sizeof(double) / header.dim);
+
+    if (header.values_offset % SECTION_ALIGNMENT != 0 || header.labels_offset % SECTION_ALIGNMENT != 0 ||
+            header.weights_offset % SECTION_ALIGNMENT != 0 || !values_fit ||
+            !sectionFits(header.labels_offset, header.nsamples, sizeof(int32_t), file_size) ||
+            (has_weights && !sectionFits(header.weights_offset, header.nsamples, sizeof(double), file_size)))
+        throw runtime_error("Corrupted binary dataset: " + filename);
+
+    const double * values = reinterpret_cast<const double *>(mapping->data() + header.values_offset);
+    const int * labels = reinterpret_cast<const int *>(mapping->data() + header.labels_offset);
+
+    if (out_weights != nullptr && has_weights)
+    {
+        const double * weights = reinterpret_cast<const double *>(mapping->data() + header.weights_offset);
+        out_weights->assign(weights, weights + header.nsamples);
+    }
+
+    return Dataset(Dataset::COLUMN_MAJOR, header.nsamples, header.dim, values, labels, mapping);
+}
+
+void ConvertCsvToBinaryDataset(const string & csv_filename, const string & binary_filename)
+{
+    SaveBinaryDataset(LoadCsvDataset(csv_filename), binary_filename);
+}
@@ -0,0 +1,58 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINARY_DATASET_H_
+#define BINARY_DATASET_H_
+
+#include <string>
+#include <vector>
+
+#include "dataset.h"
+
+// Binary dataset format (version 1), in native (little-endian) byte order:
+//
+//   header   64 bytes: magic "LAKEMLDS", uint32 version, uint32 flags,
+//            uint64 nsamples, uint64 dimension, and the uint64 byte offsets
+//            of the three sections below
+//   values   nsamples * dimension doubles, one contiguous column per feature
+//   labels   nsamples int32
+//   weights  nsamples doubles, only present if flags has BINARY_DATASET_HAS_WEIGHTS
+//
+// Every section starts at a 64-byte aligned offset, so it can be used in place
+// from a memory mapping of the file.
+
+const unsigned int BINARY_DATASET_VERSION = 1;
+const unsigned int BINARY_DATASET_HAS_WEIGHTS = 1;
+
+// Writes 'dataset' (and 'weights', if not null) to 'filename'.
+// Throws std::runtime_error if the file can not be written.
+void SaveBinaryDataset(const Dataset & dataset, const std::string & filename,
+                       const std::vector<double> * weights = nullptr);
+
+// Maps 'filename' into memory and returns a column-major Dataset that reads its samples
+// and labels directly from the mapping, so loading takes the same time whatever the size
+// of the dataset, and processes loading the same file share its pages. If the file has
+// weights and 'out_weights' is not null, they are copied into it.
+// Throws std::runtime_error if the file can not be read or is not in the format above.
+Dataset LoadBinaryDataset(const std::string & filename, std::vector<double> * out_weights = nullptr);
+
+// One-time conversion of a CSV file (see LoadCsvDataset) to the binary format.
+void ConvertCsvToBinaryDataset(const std::string & csv_filename, const std::string & binary_filename);
+
+#endif  // BINARY_DATASET_H_
@@ -0,0 +1,137 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "binned_features.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+const uint8_t BinnedFeatures::MISSING;
+const unsigned int BinnedFeatures::MAX_BINS;
+
+BinnedFeatures::BinnedFeatures(const Dataset & dataset, size_t first, size_t end) :
+    nsamples(dataset.size()),
+    dim(dataset.dimension()),
+    first_feature(first),
+    end_feature(end),
+    lower_edges(dim),
+    codes((end - first) * nsamples)
+{
+}
+
+BinnedFeatures::BinnedFeatures(const Dataset & dataset, unsigned int max_bins, int nthreads) :
+    BinnedFeatures(dataset, 0, dataset.dimension())
+{
+    assert(max_bins > 0 && max_bins <= MAX_BINS);
+
+    ThreadPool pool(nthreads);
+    vector< vector<double> > sorted_values(pool.size());
+
+    pool.run(dim, [&](size_t d, int worker) {
+        binFeature(dataset, d, max_bins, sorted_values[worker]);
+    });
+}
+
+BinnedFeatures BinnedFeatures::singleFeature(const Dataset & dataset, size_t feature_index, unsigned int max_bins)
+{
+    assert(max_bins > 0 && max_bins <= MAX_BINS);
+    assert(feature_index < dataset.dimension());
+
+    BinnedFeatures bins(dataset, feature_index, feature_index + 1);
+    vector<double> sorted;
+    bins.binFeature(dataset, feature_index, max_bins, sorted);
+    return bins;
+}
+
+void BinnedFeatures::binFeature(const Dataset & dataset, size_t d, unsigned int max_bins, vector<double> & sorted)
+{
+    FeatureColumn column = dataset.column(d);
+
+    sorted.clear();
+    for (size_t i = 0; i < nsamples; i++)
+        if (isfinite(column[i]))
+            sorted.push_back(column[i]);
+
+    sort(sorted.begin(), sorted.end());
+
+    // each bin takes an equal share of the samples left, and all the copies of its last value
+    vector<double> & edges = lower_edges[d];
+    size_t first = 0;
+    while (first < sorted.size())
+    {
+        edges.push_back(sorted[first]);
+
+        size_t bins_left = max_bins - edges.size() + 1;
+        size_t end = first + max<size_t>(1, (sorted.size() - first) / bins_left);
+        while (end < sorted.size() && sorted[end] == sorted[end - 1])
+            end++;
+
+        first = end;
+    }
+
+    uint8_t * feature_codes = &codes[(d - first_feature) * nsamples];
+    for (size_t i = 0; i < nsamples; i++)
+        feature_codes[i] = binOf(d, column[i]);
+}
+
+size_t BinnedFeatures::dimension() const
+{
+    return dim;
+}
+
+size_t BinnedFeatures::numBins(size_t feature_index) const
+{
+    assert(feature_index < dim);
+    return lower_edges[feature_index].size();
+}
+
+double BinnedFeatures::lowerEdge(size_t feature_index, size_t bin) const
+{
+    assert(bin < numBins(feature_index));
+    return lower_edges[feature_index][bin];
+}
+
+const uint8_t * BinnedFeatures::binCodes(size_t feature_index) const
+{
+    assert(feature_index >= first_feature && feature_index < end_feature);
+    return codes.data() + (feature_index - first_feature) * nsamples;
+}
+
+uint8_t BinnedFeatures::binOf(size_t feature_index, double value) const
+{
+    const vector<double> & edges = lower_edges[feature_index];
+
+    if (!isfinite(value) || edges.empty())
+        return MISSING;
+
+    size_t bin = upper_bound(edges.begin(), edges.end(), value) - edges.begin();
+    return (bin == 0) ? 0 : static_cast<uint8_t>(bin - 1);
+}
+
+const BinnedFeatures & CacheBinnedFeatures(const Dataset & dataset, int nthreads)
+{
+    if (!dataset.binned_features)
+        dataset.binned_features.reset(new BinnedFeatures(dataset, BinnedFeatures::MAX_BINS, nthreads));
+
+    return *dataset.binned_features;
+}
@@ -0,0 +1,79 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINNED_FEATURES_H_
+#define BINNED_FEATURES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dataset.h"
+
+/// Features of a dataset quantized into at most 255 quantile bins each, stored as one
+/// byte per value (8 times less than the samples), for histogram-based split search.
+/// Bin b of a feature holds the values in [lowerEdge(b), lowerEdge(b + 1)); the edges
+/// are values of the dataset. Values that are not finite get the code MISSING.
+class BinnedFeatures
+{
+public:
+
+    static const uint8_t MISSING = 255;
+    static const unsigned int MAX_BINS = 255;
+
+    // bins the features of 'dataset' in parallel with 'nthreads' threads (one per core if <= 0)
+    explicit BinnedFeatures(const Dataset & dataset, unsigned int max_bins = MAX_BINS, int nthreads = 0);
+
+    // bins only the feature 'feature_index' of 'dataset' (the other features have no bins)
+    static BinnedFeatures singleFeature(const Dataset & dataset, size_t feature_index,
+                                        unsigned int max_bins = MAX_BINS);
+
+    size_t dimension() const;
+
+    size_t numBins(size_t feature_index) const;
+
+    // smallest value of the dataset that falls in the bin
+    double lowerEdge(size_t feature_index, size_t bin) const;
+
+    // bin of each sample (or MISSING), in the order of the dataset
+    const uint8_t * binCodes(size_t feature_index) const;
+
+    // bin of any value (values below the first edge go to the first bin)
+    uint8_t binOf(size_t feature_index, double value) const;
+
+private:
+
+    // empty bins for all the features, and room for the codes of features [first, end)
+    BinnedFeatures(const Dataset & dataset, size_t first, size_t end);
+
+    // computes the edges and codes of feature d, using 'sorted' as scratch space
+    void binFeature(const Dataset & dataset, size_t d, unsigned int max_bins, std::vector<double> & sorted);
+
+    size_t nsamples, dim;
+    size_t first_feature, end_feature;      // features [first_feature, end_feature) have codes
+    std::vector< std::vector<double> > lower_edges;
+    std::vector<uint8_t> codes;     // feature d starts at (d - first_feature) * nsamples
+};
+
+// Returns the bins cached in 'dataset', computing them first if the dataset has none.
+// The cache is shared by copies of the dataset and dropped when it is modified.
+// The first call must not run concurrently with other uses of the dataset.
+const BinnedFeatures & CacheBinnedFeatures(const Dataset & dataset, int nthreads = 0);
+
+#endif  // BINNED_FEATURES_H_
@@ -17,18 +17,38 @@
  *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <float.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <typeinfo>
 
 #include "boosted_classifier.h"
 #include "math_utils.h"
+#include "model_file.h"
+#include "sorted_feature_index.h"
+#include "stump_ensemble.h"
+#include "thread_pool.h"
+#include "threshold_learner.h"
 
 using namespace std;
 
 
-BoostedClassifier::BoostedClassifier()
+BoostedClassifier::BoostedClassifier() :
+    all_stumps(false),
+    num_threads(1),
+    sample_selection(ALL_SAMPLES),
+    kept_weight_fraction(1.0),
+    top_fraction(1.0),
+    other_fraction(0.0),
+    sampling_seed(0),
+    checkpoint_interval(0)
 {
 }
 
@@ -36,6 +56,14 @@ BoostedClassifier::BoostedClassifier(const ClassifierFactory* classifier_factory
     classifier_factory(classifier_factory_),
     learners_to_add(max_weak_learners_),
     trials_per_learner(weak_learner_trials_),
+    all_stumps(false),
+    num_threads(1),
+    sample_selection(ALL_SAMPLES),
+    kept_weight_fraction(1.0),
+    top_fraction(1.0),
+    other_fraction(0.0),
+    sampling_seed(0),
+    checkpoint_interval(0),
     weak_learners_weights(),
     weak_learners(),
     decision_threshold(0)
@@ -43,71 +71,262 @@ BoostedClassifier::BoostedClassifier(const ClassifierFactory* classifier_factory
 
 }
 
+BoostedClassifier::BoostedClassifier(int max_weak_learners_):
+    classifier_factory(nullptr),
+    learners_to_add(max_weak_learners_),
+    trials_per_learner(0),
+    all_stumps(true),
+    num_threads(1),
+    sample_selection(ALL_SAMPLES),
+    kept_weight_fraction(1.0),
+    top_fraction(1.0),
+    other_fraction(0.0),
+    sampling_seed(0),
+    checkpoint_interval(0),
+    weak_learners_weights(),
+    weak_learners(),
+    decision_threshold(0)
+{
+
+}
 
-int BoostedClassifier::getNumWeakLearners()
+BoostedClassifier::~BoostedClassifier()
+{
+    for (size_t c = 0; c < spare_candidates.size(); c++)
+        delete spare_candidates[c];
+}
+
+int BoostedClassifier::getNumWeakLearners() const
 {
     return weak_learners.size();
 }
 
+const Classifier * BoostedClassifier::getWeakLearner(int index) const
+{
+    assert(index >= 0 && index < (int) weak_learners.size());
+    return weak_learners[index];
+}
+
+double BoostedClassifier::getWeakLearnerWeight(int index) const
+{
+    assert(index >= 0 && index < (int) weak_learners_weights.size());
+    return weak_learners_weights[index];
+}
+
+double BoostedClassifier::getDecisionThreshold() const
+{
+    return decision_threshold;
+}
+
+void BoostedClassifier::setNumThreads(int nthreads)
+{
+    num_threads = nthreads;
+}
+
+void BoostedClassifier::setWeightTrimming(double kept_weight_fraction_)
+{
+    assert(kept_weight_fraction_ > 0.0 && kept_weight_fraction_ <= 1.0);
+
+    sample_selection = (kept_weight_fraction_ < 1.0) ? WEIGHT_TRIMMING : ALL_SAMPLES;
+    kept_weight_fraction = kept_weight_fraction_;
+}
+
+void BoostedClassifier::setGradientSampling(double top_fraction_, double other_fraction_, unsigned int seed)
+{
+    assert(top_fraction_ > 0.0 && other_fraction_ > 0.0);
+    assert(top_fraction_ + other_fraction_ <= 1.0);
+
+    sample_selection = GRADIENT_SAMPLING;
+    top_fraction = top_fraction_;
+    other_fraction = other_fraction_;
+    sampling_seed = seed;
+}
+
+void BoostedClassifier::setCheckpoint(const string & filename, int every_rounds)
+{
+    assert(every_rounds > 0);
+
+    checkpoint_filename = filename;
+    checkpoint_interval = every_rounds;
+}
+
+void BoostedClassifier::saveCheckpoint() const
+{
+    // a job stopped while writing leaves the previous checkpoint intact
+    string temporary = checkpoint_filename + ".tmp";
+    SaveModel(*this, temporary);
+
+    if (rename(temporary.c_str(), checkpoint_filename.c_str()) != 0)
+        throw runtime_error("Can not write checkpoint " + checkpoint_filename);
+}
+
+// responses of 'classifier' on the samples of 'dataset', in blocks run by 'pool'
+static void ResponseAll(const BoostedClassifier & classifier, const Dataset & dataset, vector<double> & out, ThreadPool & pool)
+{
+    size_t nsamples = dataset.size(), block_size = 4096;
+    out.resize(nsamples);
+
+    // decision stumps are compiled and scored a block of samples at a time (same results)
+    bool stumps = true;
+    for (int m = 0; m < classifier.getNumWeakLearners(); m++)
+        stumps = stumps && dynamic_cast<const ThresholdLearner *>(classifier.getWeakLearner(m)) != nullptr;
+
+    StumpEnsemble ensemble;
+    if (stumps)
+        ensemble = StumpEnsemble(classifier);
+
+    pool.run((nsamples + block_size - 1) / block_size, [&](size_t block, int) {
+        size_t first = block * block_size, count = min(block_size, nsamples - first);
+        if (stumps)
+            ensemble.response(dataset, first, count, &out[first]);
+        else
+            for (size_t i = first; i < first + count; i++)
+                out[i] = classifier.response(dataset[i]);
+    });
+}
+
+// classifies the samples of 'dataset' in blocks run by 'pool'
+static void ClassifyAll(const Classifier & classifier, const Dataset & dataset, vector<int8_t> & out, ThreadPool & pool)
+{
+    size_t nsamples = dataset.size(), block_size = 4096;
+    out.resize(nsamples);
+
+    pool.run((nsamples + block_size - 1) / block_size, [&](size_t block, int) {
+        for (size_t i = block * block_size; i < min(nsamples, (block + 1) * block_size); i++)
+            out[i] = classifier.classify(dataset[i]);
+    });
+}
+
 void BoostedClassifier::train(const Dataset & training_dataset, const vector<double> & initial_data_weights)
+{
+    boost(training_dataset, initial_data_weights, nullptr, 0);
+}
+
+void BoostedClassifier::train(const Dataset & training_dataset, const vector<double> & initial_data_weights,
+                              const Dataset & validation_dataset, int patience)
+{
+    assert(validation_dataset.size() > 0);
+    assert(patience > 0);
+
+    boost(training_dataset, initial_data_weights, &validation_dataset, patience);
+}
+
+const vector<double> & BoostedClassifier::getValidationLosses() const
+{
+    return validation_losses;
+}
+
+void BoostedClassifier::boost(const Dataset & training_dataset, const vector<double> & initial_data_weights,
+                              const Dataset * validation_dataset, int patience)
 {
     // assertions
     {
-        assert(classifier_factory != nullptr);
+        assert(all_stumps || classifier_factory != nullptr);
         assert(training_dataset.size() > 0);
         assert(learners_to_add > 0);
-        assert(trials_per_learner > 0);
+        assert(all_stumps || trials_per_learner > 0);
         assert(initial_data_weights.size() == training_dataset.size());
     }
 
-    // initialize vectors with the size of the dataset
-    responses.clear();
-    curr_weak_learner_predictions.clear();
-    best_weak_learner_predictions.clear();
-    curr_data_weights.clear();
+    // the cascade was calibrated for the previous weak learners
+    rejection_thresholds.clear();
+
+    // trials run in parallel, each worker keeping the predictions of its best trial
+    ThreadPool pool(num_threads);
+
+    // initialize vectors with the size of the dataset; the responses of the weak learners
+    // already trained (warm start) are computed in one pass over the samples, and equal the
+    // ones their rounds accumulated
+    responses.assign(training_dataset.size(), 0.0);
+    best_weak_learner_predictions.assign(training_dataset.size(), 0);
+    curr_data_weights = initial_data_weights;
 
+    if (!weak_learners.empty())
+    {
+        ResponseAll(*this, training_dataset, responses, pool);
+        loss_function.value(training_dataset, initial_data_weights, responses, curr_data_weights);
+    }
+    worker_predictions.resize(pool.size());
+    worker_best_predictions.resize(pool.size());
+
+    labels.resize(training_dataset.size());
     for (size_t i = 0; i < training_dataset.size(); i++)
     {
-        responses.push_back(0.0);
-        curr_weak_learner_predictions.push_back(0);
-        best_weak_learner_predictions.push_back(0);
-        curr_data_weights.push_back(initial_data_weights[i]);
+        int label = training_dataset.getLabelAt(i);
+        if (label < -1 || label > 1)
+            throw invalid_argument("BoostedClassifier: label " + to_string(label) + " of sample " +
+                                   to_string(i) + " is not -1, 0 or 1");
+        labels[i] = label;
     }
 
-    for (int wl = 0; wl < learners_to_add; wl++)
+    bool subsampled = sample_selection != ALL_SAMPLES;
+    if (all_stumps)
+        CacheSortedFeatureIndex(training_dataset, num_threads);
+
+    // responses of the classifier on the validation samples, updated after each round
+    vector<double> validation_responses, validation_weights, validation_sample_losses;
+    vector<int8_t> validation_predictions;
+    size_t best_num_learners = weak_learners.size();
+    double best_validation_loss = DBL_MAX;
+    validation_losses.clear();
+
+    if (validation_dataset != nullptr)
     {
-        double min_loss = DBL_MAX, best_weak_learner_weight;
-        Classifier * best_weak_learner = nullptr;
+        ResponseAll(*this, *validation_dataset, validation_responses, pool);
 
-        for (int trial = 0; trial < trials_per_learner; trial++)
+        validation_weights.assign(validation_dataset->size(), 1.0);
+        validation_sample_losses.resize(validation_dataset->size());
+        loss_function.value(*validation_dataset, validation_weights, validation_responses, validation_sample_losses);
+        best_validation_loss = accumulate(validation_sample_losses.begin(), validation_sample_losses.end(), 0.0);
+        validation_losses.push_back(best_validation_loss);
+    }
+
+    while ((int) weak_learners.size() < learners_to_add)
+    {
+        if (subsampled)
         {
-            Classifier * current_weak_learner = classifier_factory->createRandomInstance();
-            current_weak_learner->train(training_dataset, curr_data_weights);
-            curr_weak_learner_predictions = current_weak_learner->classify(training_dataset);
+            // the samples drawn depend only on the seed and the round, not on the number of
+            // threads nor on where an interrupted training resumed
+            seed_seq round_seed = {sampling_seed, (unsigned int) weak_learners.size()};
+            mt19937 rng(round_seed);
+            selectSubset(training_dataset.size(), rng);
+        }
 
-            double optimal_step, loss_after_step;
-            loss_function->optimal_step_along_direction(training_dataset, initial_data_weights,
-                    responses, curr_weak_learner_predictions,
-                    &optimal_step, &loss_after_step);
+        // the candidates train on all the samples, those left out having a zero weight, and are
+        // compared on the searched samples only
+        const vector<double> & train_weights = subsampled ? subset_weights : curr_data_weights;
+        const vector<unsigned int> * searched = subsampled ? &subset_samples : nullptr;
+        const vector<int8_t> & searched_labels = subsampled ? subset_labels : labels;
+        const vector<double> & searched_losses = subsampled ? subset_losses : curr_data_weights;
 
-            if ( loss_after_step < min_loss )
-            {
-                min_loss = loss_after_step;
-                best_weak_learner_weight = optimal_step;
-                if (best_weak_learner != nullptr)
-                    delete best_weak_learner;    // delete previous best
-                best_weak_learner = current_weak_learner;
-                best_weak_learner_predictions = curr_weak_learner_predictions;
-            }
-            else
-                delete current_weak_learner;
+        for (int w = 0; w < pool.size(); w++)
+        {
+            worker_predictions[w].resize(searched_labels.size());
+            worker_best_predictions[w].resize(searched_labels.size());
         }
 
+        double best_weak_learner_weight = 0.0;
+        Classifier * best_weak_learner = all_stumps ?
+                                         bestOfAllStumps(training_dataset, train_weights, searched, searched_labels,
+                                                         searched_losses, pool, &best_weak_learner_weight) :
+                                         bestOfTrials(training_dataset, train_weights, searched, searched_labels,
+                                                      searched_losses, pool, &best_weak_learner_weight);
+
         assert(best_weak_learner != nullptr);
+
+        if (subsampled)
+        {
+            // the weight of the weak learner is the optimal step on all the samples
+            ClassifyAll(*best_weak_learner, training_dataset, best_weak_learner_predictions, pool);
+
+            double loss_after_step;
+            loss_function.optimal_step_along_direction(labels, curr_data_weights, best_weak_learner_predictions,
+                    &best_weak_learner_weight, &loss_after_step);
+        }
+
         assert(isfinite(best_weak_learner_weight));
 
-        // add best weak learner to strong classifier
-        weak_learners.push_back(best_weak_learner);
+        // the best weak learner was added to the strong classifier
         weak_learners_weights.push_back(best_weak_learner_weight);
 
         // update strong classifier responses
@@ -115,12 +334,304 @@ void BoostedClassifier::train(const Dataset & training_dataset, const vector<dou
             responses[i] += best_weak_learner_weight * best_weak_learner_predictions[i];
 
         // update data weights for next round
-        loss_function->value(training_dataset, initial_data_weights, responses, curr_data_weights);
+        loss_function.value(training_dataset, initial_data_weights, responses, curr_data_weights);
+
+        if (validation_dataset != nullptr)
+        {
+            // only the new weak learner is evaluated
+            ClassifyAll(*best_weak_learner, *validation_dataset, validation_predictions, pool);
+            for (size_t i = 0; i < validation_dataset->size(); i++)
+                validation_responses[i] += best_weak_learner_weight * validation_predictions[i];
+
+            loss_function.value(*validation_dataset, validation_weights, validation_responses, validation_sample_losses);
+            double validation_loss = accumulate(validation_sample_losses.begin(), validation_sample_losses.end(), 0.0);
+
+            validation_losses.push_back(validation_loss);
+            if (validation_loss < best_validation_loss)
+            {
+                best_validation_loss = validation_loss;
+                best_num_learners = weak_learners.size();
+            }
+
+            if ((int) (weak_learners.size() - best_num_learners) >= patience)
+                break;
+        }
+
+        if (checkpoint_interval > 0 && weak_learners.size() % checkpoint_interval == 0)
+            saveCheckpoint();
+    }
+
+    if (validation_dataset != nullptr)
+    {
+        // keep the weak learners up to the best round
+        weak_learners.truncate(best_num_learners);
+        weak_learners_weights.resize(best_num_learners);
+    }
+
+    for (size_t c = 0; c < spare_candidates.size(); c++)
+        delete spare_candidates[c];
+
+    spare_candidates.clear();
+}
+
+Classifier * BoostedClassifier::bestOfTrials(const Dataset & training_dataset, const vector<double> & train_weights,
+        const vector<unsigned int> * searched, const vector<int8_t> & sample_labels,
+        const vector<double> & sample_losses, ThreadPool & pool, double * out_weight)
+{
+    vector<Classifier *> candidates(trials_per_learner);
+    vector<double> optimal_steps(trials_per_learner), losses_after_step(trials_per_learner);
+    vector<double> worker_min_loss(pool.size(), DBL_MAX);
+    vector<int> worker_best_trial(pool.size(), -1);
+
+    // candidates are drawn in turn, so the factory sees the same calls as in a serial run
+    for (int trial = 0; trial < trials_per_learner; trial++)
+    {
+        if (spare_candidates.empty())
+            candidates[trial] = classifier_factory->createRandomInstance();
+        else
+        {
+            candidates[trial] = classifier_factory->recycleRandomInstance(spare_candidates.back());
+            spare_candidates.pop_back();
+        }
+
+        // indices such as the sorted features are computed once, all rounds and trials share them
+        candidates[trial]->prepareTraining(training_dataset, num_threads);
+    }
+
+    try
+    {
+        pool.run(trials_per_learner, [&](size_t trial, int worker) {
+            Classifier * current_weak_learner = candidates[trial];
+            current_weak_learner->train(training_dataset, train_weights);
+
+            vector<int8_t> & predictions = worker_predictions[worker];
+            for (size_t k = 0; k < sample_labels.size(); k++)
+                predictions[k] = current_weak_learner->classify(training_dataset[(searched != nullptr) ? (*searched)[k] : k]);
 
+            loss_function.optimal_step_along_direction(sample_labels, sample_losses, predictions,
+                    &optimal_steps[trial], &losses_after_step[trial]);
+
+            // ties go to the first trial, as when trials run in turn
+            double loss_after_step = losses_after_step[trial];
+            int & best_trial = worker_best_trial[worker];
+            if ( loss_after_step < worker_min_loss[worker] ||
+                 (loss_after_step == worker_min_loss[worker] && (int) trial < best_trial) )
+            {
+                worker_min_loss[worker] = loss_after_step;
+                best_trial = trial;
+                worker_best_predictions[worker].swap(predictions);
+            }
+        });
+    }
+    catch (...)
+    {
+        for (int trial = 0; trial < trials_per_learner; trial++)
+            delete candidates[trial];
+        throw;
+    }
+
+    // same reduction across workers
+    double min_loss = DBL_MAX;
+    int best_worker = -1, best_trial = -1;
+    for (int w = 0; w < pool.size(); w++)
+    {
+        if (worker_best_trial[w] < 0)
+            continue;
+
+        if ( worker_min_loss[w] < min_loss ||
+             (worker_min_loss[w] == min_loss && worker_best_trial[w] < best_trial) )
+        {
+            min_loss = worker_min_loss[w];
+            best_worker = w;
+            best_trial = worker_best_trial[w];
+        }
+    }
+
+    // the others are recycled in the next round
+    for (int trial = trials_per_learner - 1; trial >= 0; trial--)
+        if (trial != best_trial)
+            spare_candidates.push_back(candidates[trial]);
+
+    if (best_trial < 0)
+        return nullptr;
+
+    *out_weight = optimal_steps[best_trial];
+    best_weak_learner_predictions.swap(worker_best_predictions[best_worker]);
+
+    // a winning stump is copied into the arena, packed with the other weak learners, and recycled
+    // like the losers; classifiers of other types are adopted as the factory allocated them
+    Classifier * winner = candidates[best_trial];
+    if (typeid(*winner) == typeid(ThresholdLearner))
+    {
+        spare_candidates.push_back(winner);
+        return weak_learners.create<ThresholdLearner>(*static_cast<ThresholdLearner *>(winner));
+    }
+
+    return weak_learners.adopt(winner);
+}
+
+Classifier * BoostedClassifier::bestOfAllStumps(const Dataset & dataset, const vector<double> & train_weights,
+        const vector<unsigned int> * searched, const vector<int8_t> & sample_labels,
+        const vector<double> & sample_losses, ThreadPool & pool, double * out_weight)
+{
+    const SortedFeatureIndex & sorted_index = *dataset.sortedIndex();
+    size_t dim = dataset.dimension();
+    vector<int> stump_labels(labels.begin(), labels.end());
+
+    vector<double> optimal_steps(dim), losses_after_step(dim);
+    vector<double> worker_min_loss(pool.size(), DBL_MAX);
+    vector<int> worker_best_feature(pool.size(), -1);
+    vector<double> thresholds(dim);
+    vector<int> labels_on_left(dim);
+
+    // one stump per feature, trained on the stack
+    pool.run(dim, [&](size_t feature, int worker) {
+        ThresholdLearner stump(feature);
+        stump.train(dataset, sorted_index, stump_labels, train_weights);
+        thresholds[feature] = stump.getThreshold();
+        labels_on_left[feature] = stump.getLabelOnLeft();
+
+        FeatureColumn feature_column = dataset.column(feature);
+        vector<int8_t> & predictions = worker_predictions[worker];
+
+        for (size_t k = 0; k < sample_labels.size(); k++)
+        {
+            // same rule as ThresholdLearner::classify
+            double resp = feature_column[(searched != nullptr) ? (*searched)[k] : k] - stump.getThreshold();
+            predictions[k] = !isfinite(resp) ? 0 : (resp < 0) ? stump.getLabelOnLeft() : -stump.getLabelOnLeft();
+        }
+
+        loss_function.optimal_step_along_direction(sample_labels, sample_losses, predictions,
+                &optimal_steps[feature], &losses_after_step[feature]);
+
+        // ties go to the first feature
+        double loss_after_step = losses_after_step[feature];
+        int & best_feature = worker_best_feature[worker];
+        if ( loss_after_step < worker_min_loss[worker] ||
+             (loss_after_step == worker_min_loss[worker] && (int) feature < best_feature) )
+        {
+            worker_min_loss[worker] = loss_after_step;
+            best_feature = feature;
+            worker_best_predictions[worker].swap(predictions);
+        }
+    });
+
+    double min_loss = DBL_MAX;
+    int best_worker = -1, best_feature = -1;
+    for (int w = 0; w < pool.size(); w++)
+    {
+        if (worker_best_feature[w] < 0)
+            continue;
+
+        if ( worker_min_loss[w] < min_loss ||
+             (worker_min_loss[w] == min_loss && worker_best_feature[w] < best_feature) )
+        {
+            min_loss = worker_min_loss[w];
+            best_worker = w;
+            best_feature = worker_best_feature[w];
+        }
+    }
+
+    if (best_feature < 0)
+        return nullptr;
+
+    *out_weight = optimal_steps[best_feature];
+    best_weak_learner_predictions.swap(worker_best_predictions[best_worker]);
+    return weak_learners.create<ThresholdLearner>(best_feature, thresholds[best_feature], labels_on_left[best_feature]);
+}
+
+// Smallest weight such that the samples at least as heavy hold 'fraction' of the total weight.
+// Weighted quickselect: each step halves the range that holds it, so it runs in linear time.
+static double TrimmingThreshold(vector<double> weights, double fraction)
+{
+    double target = 0.0;
+    for (size_t i = 0; i < weights.size(); i++)
+        target += weights[i];
+    target *= fraction;
+
+    // the threshold is in [lo, hi) of the weights sorted by decreasing order, and the ones
+    // before lo weigh 'above' together
+    size_t lo = 0, hi = weights.size();
+    double above = 0.0;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        nth_element(weights.begin() + lo, weights.begin() + mid, weights.begin() + hi, greater<double>());
+
+        double upper = above;
+        for (size_t i = lo; i < mid; i++)
+            upper += weights[i];
+
+        if (upper >= target)
+            hi = mid;
+        else
+        {
+            above = upper;
+            lo = mid;
+        }
+    }
+
+    return weights[lo];
+}
+
+void BoostedClassifier::selectSubset(size_t nsamples, mt19937 & rng)
+{
+    // weight by which each sample is kept, 0 if left out
+    vector<double> scale(nsamples, 0.0);
+
+    if (sample_selection == WEIGHT_TRIMMING)
+    {
+        double threshold = TrimmingThreshold(curr_data_weights, kept_weight_fraction);
+        for (size_t i = 0; i < nsamples; i++)
+            if (curr_data_weights[i] >= threshold)
+                scale[i] = 1.0;
+    }
+    else
+    {
+        // the heaviest samples (ties broken by index), then a uniform draw among the others
+        size_t ntop = min(nsamples, (size_t) ceil(top_fraction * nsamples));
+        size_t nother = min(nsamples - ntop, (size_t) ceil(other_fraction * nsamples));
+
+        vector<unsigned int> order(nsamples);
+        for (size_t i = 0; i < nsamples; i++)
+            order[i] = i;
+        nth_element(order.begin(), order.begin() + ntop, order.end(), [&](unsigned int a, unsigned int b) {
+            return curr_data_weights[a] > curr_data_weights[b] ||
+                   (curr_data_weights[a] == curr_data_weights[b] && a < b);
+        });
+
+        for (size_t k = 0; k < ntop; k++)
+            scale[order[k]] = 1.0;
+
+        double other_scale = (nother > 0) ? (double) (nsamples - ntop) / nother : 0.0;
+        for (size_t k = ntop; k < ntop + nother; k++)
+        {
+            // partial Fisher-Yates shuffle of order[ntop, nsamples)
+            size_t pick = k + uniform_int_distribution<size_t>(0, nsamples - 1 - k)(rng);
+            swap(order[k], order[pick]);
+            scale[order[k]] = other_scale;
+        }
+    }
+
+    // the storage of the previous round is reused
+    subset_weights.resize(nsamples);
+    subset_samples.clear();
+    subset_losses.clear();
+    subset_labels.clear();
+
+    for (size_t i = 0; i < nsamples; i++)
+    {
+        subset_weights[i] = curr_data_weights[i] * scale[i];
+        if (scale[i] == 0.0)
+            continue;
+
+        subset_samples.push_back(i);
+        subset_losses.push_back(subset_weights[i]);
+        subset_labels.push_back(labels[i]);
     }
 }
 
-double BoostedClassifier::response(const DataInstance & data_instance, int first_weak_learner, int nb_weak_learners) const
+double BoostedClassifier::response(const DataRow & data_instance, int first_weak_learner, int nb_weak_learners) const
 {
     assert( first_weak_learner >= 0);
     assert( first_weak_learner + nb_weak_learners <= (int) weak_learners.size());
@@ -135,7 +646,7 @@ double BoostedClassifier::response(const DataInstance & data_instance, int first
     return resp;
 }
 
-double BoostedClassifier::response(const DataInstance & data_instance) const
+double BoostedClassifier::response(const DataRow & data_instance) const
 {
     double resp = 0.0;
 
@@ -147,9 +658,81 @@ double BoostedClassifier::response(const DataInstance & data_instance) const
     return resp;
 }
 
-int BoostedClassifier::classify(const DataInstance & data_instance) const
+int BoostedClassifier::classify(const DataRow & data_instance) const
 {
-    double resp = response(data_instance);
+    return classify(data_instance, nullptr);
+}
+
+int BoostedClassifier::classify(const DataRow & data_instance, int * out_nb_evaluated) const
+{
+    if (rejection_thresholds.empty())
+    {
+        if (out_nb_evaluated != nullptr)
+            *out_nb_evaluated = weak_learners.size();
+
+        double resp = response(data_instance);
+        return ((resp <= decision_threshold) ? -1 : 1);
+    }
+
+    // same sum as response(), stopping at the first stage that rejects the sample
+    double resp = 0.0;
+
+    for (unsigned int m = 0; m < weak_learners.size(); m++)
+    {
+        resp += weak_learners_weights[m] * weak_learners[m]->classify(data_instance);
+
+        if (resp < rejection_thresholds[m])
+        {
+            if (out_nb_evaluated != nullptr)
+                *out_nb_evaluated = m + 1;
+            return -1;
+        }
+    }
+
+    if (out_nb_evaluated != nullptr)
+        *out_nb_evaluated = weak_learners.size();
+
     return ((resp <= decision_threshold) ? -1 : 1);
 }
 
+void BoostedClassifier::calibrateSoftCascade(const Dataset & calibration_dataset)
+{
+    // no threshold rejects anything until a kept positive is seen
+    vector<double> thresholds(weak_learners.size(), -INFINITY);
+    vector<double> partial_responses(weak_learners.size());
+
+    for (size_t i = 0; i < calibration_dataset.size(); i++)
+    {
+        if (calibration_dataset.getLabelAt(i) <= 0)
+            continue;
+
+        double resp = 0.0;
+        for (unsigned int m = 0; m < weak_learners.size(); m++)
+        {
+            resp += weak_learners_weights[m] * weak_learners[m]->classify(calibration_dataset[i]);
+            partial_responses[m] = resp;
+        }
+
+        // only positives that the whole classifier accepts constrain the stages
+        if (resp <= decision_threshold)
+            continue;
+
+        for (unsigned int m = 0; m < weak_learners.size(); m++)
+        {
+            if (thresholds[m] == -INFINITY || partial_responses[m] < thresholds[m])
+                thresholds[m] = partial_responses[m];
+        }
+    }
+
+    rejection_thresholds.swap(thresholds);
+}
+
+bool BoostedClassifier::hasSoftCascade() const
+{
+    return !rejection_thresholds.empty();
+}
+
+const vector<double> & BoostedClassifier::getRejectionThresholds() const
+{
+    return rejection_thresholds;
+}
@@ -23,13 +23,19 @@
 #ifndef BOOSTEDLEARNER
 #define BOOSTEDLEARNER
 
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <string>
 #include <vector>
 
 #include "classifier.h"
+#include "classifier_arena.h"
 #include "classifier_factory.h"
 #include "exponential_loss.h"
 
+class ThreadPool;
+
 /// Linear combination of classifiers (weak learners) trained by the AdaBoost algorithm
 class BoostedClassifier : public Classifier {
 
@@ -37,32 +43,144 @@ public:
 
     BoostedClassifier();
     BoostedClassifier(const ClassifierFactory * classifier_factory, int max_weak_learners, int weak_learner_trials);
-
-    int  getNumWeakLearners();
-
-    // declared virtual in Classifier
+    // Boosts decision stumps (ThresholdLearner), adding at each round the best one over all
+    // the features instead of the best of trials drawn from a factory
+    explicit BoostedClassifier(int max_weak_learners);
+    ~BoostedClassifier();
+
+    int  getNumWeakLearners() const;
+    const Classifier * getWeakLearner(int index) const;
+    double getWeakLearnerWeight(int index) const;
+    double getDecisionThreshold() const;
+
+    // Number of threads training and evaluating the trials (or features) of a round in parallel
+    // (1, the default, trains them in turn; <= 0 uses one thread per core).
+    // The weak learners must then be safe to train concurrently on the same dataset.
+    // The result does not depend on it.
+    void setNumThreads(int nthreads);
+
+    // The candidate weak learners of each round can be searched on a subset of the training
+    // samples, which the current weights concentrate on after a few rounds:
+    //  - weight trimming keeps the heaviest samples, which hold 'kept_weight_fraction' of the
+    //    weight (1, the default, keeps all the samples)
+    //  - gradient-based sampling (GOSS) keeps the 'top_fraction' heaviest samples plus
+    //    'other_fraction' of the samples drawn at random among the others, whose weights are
+    //    scaled up to stand for the ones left out
+    // The candidates are trained on all the samples, those left out having a zero weight (a
+    // ThresholdLearner skips them as it scans the sorted samples), and compared on the kept ones. The weight of the chosen weak learner is still computed on all
+    // the samples.
+    void setWeightTrimming(double kept_weight_fraction);
+    void setGradientSampling(double top_fraction, double other_fraction, unsigned int seed);
+
+    // Saves the classifier to 'filename' (see SaveModel) every 'every_rounds' rounds of training,
+    // replacing the previous checkpoint atomically. A job stopped during training resumes by
+    // loading the checkpoint into a classifier built with the same parameters (see LoadModel) and
+    // training it again. The weak learners must be decision stumps (ThresholdLearner).
+    void setCheckpoint(const std::string & filename, int every_rounds);
+
+    // declared virtual in Classifier. Training continues from the weak learners the classifier
+    // already has, if any (warm start), adding rounds until it has max_weak_learners. The rounds
+    // added are those of a single uninterrupted training, except that the factory may draw
+    // different candidates. Throws std::invalid_argument if a label is not -1, 0 or 1.
     void   train(const Dataset & training_dataset, const std::vector<double> &weights);
-    int    classify(const DataInstance & data_instance) const;
-    double response(const DataInstance & data_instance) const;
+
+    // Trains with early stopping: after each round, the exponential loss on 'validation_dataset'
+    // is updated with the new weak learner only (linear in the number of validation samples).
+    // Training stops when it has not improved for 'patience' rounds, and the weak learners
+    // added after the best round are removed.
+    void   train(const Dataset & training_dataset, const std::vector<double> &weights,
+                 const Dataset & validation_dataset, int patience);
+
+    // validation loss after each round of the last training with early stopping, the first
+    // value being the loss before the first round
+    const std::vector<double> & getValidationLosses() const;
+    int    classify(const DataRow & data_instance) const;
+    double response(const DataRow & data_instance) const;
     // response using only the part of the weak learners
-    double response(const DataInstance & data_instance, int first_weak_learner, int nb_weak_learners) const;
+    double response(const DataRow & data_instance, int first_weak_learner, int nb_weak_learners) const;
+
+    // Soft cascade: sets after each weak learner a rejection threshold on the partial response,
+    // the lowest one reached by the positive samples of 'calibration_dataset' that the classifier
+    // accepts. classify() then rejects a sample as soon as its partial response falls below the
+    // threshold of the current stage, which keeps all these positives. Training again removes it.
+    void calibrateSoftCascade(const Dataset & calibration_dataset);
+    bool hasSoftCascade() const;
+    const std::vector<double> & getRejectionThresholds() const;
+
+    // classify, reporting in 'out_nb_evaluated' how many weak learners were evaluated
+    int    classify(const DataRow & data_instance, int * out_nb_evaluated) const;
 
 private:
 
+    // not copyable
+    BoostedClassifier(const BoostedClassifier &);
+    BoostedClassifier & operator=(const BoostedClassifier &);
+
+    friend void LoadModel(const std::string & filename, BoostedClassifier * model);
+
+    // Each round appends to weak_learners the weak learner chosen by one of these, which returns
+    // it with its weight in 'out_weight'
+    // and its predictions on the samples searched in best_weak_learner_predictions. The candidates
+    // train on the training samples with 'train_weights', and are compared on the samples
+    // 'searched' (all of them if null), with the given labels and losses at the current responses.
+    Classifier * bestOfTrials(const Dataset & training_dataset, const std::vector<double> & train_weights,
+                              const std::vector<unsigned int> * searched, const std::vector<int8_t> & sample_labels,
+                              const std::vector<double> & sample_losses, ThreadPool & pool, double * out_weight);
+    Classifier * bestOfAllStumps(const Dataset & dataset, const std::vector<double> & train_weights,
+                                 const std::vector<unsigned int> * searched, const std::vector<int8_t> & sample_labels,
+                                 const std::vector<double> & sample_losses, ThreadPool & pool, double * out_weight);
+
+    // train, with early stopping if 'validation_dataset' is not null
+    void boost(const Dataset & training_dataset, const std::vector<double> & initial_data_weights,
+               const Dataset * validation_dataset, int patience);
+
+    // fills the subset_* vectors with the samples the candidates of this round are searched on
+    void selectSubset(size_t nsamples, std::mt19937 & rng);
+
+    void saveCheckpoint() const;
+
     // parameters of learning algorithm
-    const ExponentialLoss * loss_function;
+    ExponentialLoss loss_function;
     const ClassifierFactory * classifier_factory;
     int learners_to_add;
     int trials_per_learner;
+    bool all_stumps;
+    int num_threads;
+
+    enum SampleSelection { ALL_SAMPLES, WEIGHT_TRIMMING, GRADIENT_SAMPLING };
+    SampleSelection sample_selection;
+    double kept_weight_fraction, top_fraction, other_fraction;
+    unsigned int sampling_seed;
+
+    std::string checkpoint_filename;
+    int checkpoint_interval;        // in rounds, 0 for no checkpoint
 
-    // vectors used training
+    // vectors used training; curr_data_weights is the loss of each sample at the current
+    // responses, computed once per round and shared by all the candidate weak learners
     std::vector<double> responses, curr_data_weights;
-    std::vector<int> curr_weak_learner_predictions, best_weak_learner_predictions;
+    std::vector<int8_t> labels, best_weak_learner_predictions;      // packed for the loss kernels
+    std::vector< std::vector<int8_t> > worker_predictions, worker_best_predictions;
+
+    // candidates of the previous round not kept as weak learners (the losers, and a winning stump
+    // copied into the arena), which the factory reinitializes
+    std::vector<Classifier *> spare_candidates;
+
+    // samples searched in a round when it does not search all of them: the weight of each
+    // training sample (0 if left out), and the indices, losses and labels of the kept ones
+    std::vector<double> subset_weights;
+    std::vector<unsigned int> subset_samples;
+    std::vector<double> subset_losses;
+    std::vector<int8_t> subset_labels;
 
     // results of training the boosted classifier
     std::vector<double> weak_learners_weights;
-    std::vector<Classifier *> weak_learners;
+    ClassifierArena weak_learners;
     double decision_threshold;
+
+    // rejection threshold after each weak learner (empty without soft cascade)
+    std::vector<double> rejection_thresholds;
+
+    std::vector<double> validation_losses;
 };
 
 #endif
@@ -0,0 +1,142 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOOSTED_ENSEMBLE_H_
+#define BOOSTED_ENSEMBLE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "boosted_classifier.h"
+#include "dataset.h"
+
+/// BoostedClassifier whose weak learners all have the type T (e.g. ThresholdLearner), copied by
+/// value into one contiguous vector and called without virtual dispatch, so that the compiler
+/// can inline T::classify into the loops below. Responses and classes are exactly those of the
+/// boosted classifier it was built from. Ensembles of several types keep using BoostedClassifier.
+template <class T>
+class BoostedEnsemble
+{
+public:
+
+    BoostedEnsemble() : decision_threshold(0.0)
+    {
+    }
+
+    // throws std::invalid_argument if a weak learner of 'classifier' is not exactly a T
+    explicit BoostedEnsemble(const BoostedClassifier & classifier) :
+        weights(classifier.getNumWeakLearners()),
+        rejection_thresholds(classifier.getRejectionThresholds()),
+        decision_threshold(classifier.getDecisionThreshold())
+    {
+        learners.reserve(classifier.getNumWeakLearners());
+
+        for (int m = 0; m < classifier.getNumWeakLearners(); m++)
+        {
+            const Classifier * learner = classifier.getWeakLearner(m);
+            if (typeid(*learner) != typeid(T))
+                throw std::invalid_argument("BoostedEnsemble: weak learner " + std::to_string(m) +
+                                            " is a " + typeid(*learner).name() + ", not a " + typeid(T).name());
+
+            learners.push_back(static_cast<const T &>(*learner));
+            weights[m] = classifier.getWeakLearnerWeight(m);
+        }
+    }
+
+    // number of weak learners
+    size_t size() const
+    {
+        return learners.size();
+    }
+
+    const T & getWeakLearner(size_t index) const
+    {
+        return learners[index];
+    }
+
+    double response(const DataRow & data_instance) const
+    {
+        double resp = 0.0;
+
+        for (size_t m = 0; m < learners.size(); m++)
+            resp += weights[m] * learners[m].T::classify(data_instance);
+
+        return resp;
+    }
+
+    int classify(const DataRow & data_instance) const
+    {
+        return classify(data_instance, nullptr);
+    }
+
+    // classify, reporting in 'out_nb_evaluated' how many weak learners were evaluated (fewer than
+    // size() when the soft cascade of the boosted classifier, if calibrated, rejects the sample)
+    int classify(const DataRow & data_instance, int * out_nb_evaluated) const
+    {
+        if (rejection_thresholds.empty())
+        {
+            if (out_nb_evaluated != nullptr)
+                *out_nb_evaluated = learners.size();
+
+            return (response(data_instance) <= decision_threshold) ? -1 : 1;
+        }
+
+        double resp = 0.0;
+
+        for (size_t m = 0; m < learners.size(); m++)
+        {
+            resp += weights[m] * learners[m].T::classify(data_instance);
+
+            if (resp < rejection_thresholds[m])
+            {
+                if (out_nb_evaluated != nullptr)
+                    *out_nb_evaluated = m + 1;
+                return -1;
+            }
+        }
+
+        if (out_nb_evaluated != nullptr)
+            *out_nb_evaluated = learners.size();
+
+        return (resp <= decision_threshold) ? -1 : 1;
+    }
+
+    // responses of samples [first_sample, first_sample + nsamples) of 'dataset' written to
+    // out[0, nsamples)
+    void response(const Dataset & dataset, size_t first_sample, size_t nsamples, double * out) const
+    {
+        assert(first_sample + nsamples <= dataset.size());
+
+        for (size_t i = 0; i < nsamples; i++)
+            out[i] = response(dataset[first_sample + i]);
+    }
+
+private:
+
+    std::vector<T> learners;
+    std::vector<double> weights;
+    std::vector<double> rejection_thresholds;   // see BoostedClassifier::calibrateSoftCascade
+    double decision_threshold;
+};
+
+#endif  // BOOSTED_ENSEMBLE_H_
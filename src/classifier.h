@@ -34,12 +34,18 @@ public:
     virtual ~Classifier() = 0;
 
     virtual void   train(const Dataset & training_dataset, const std::vector<double> &weights) = 0;
-    virtual double response(const DataInstance & data_instance) const = 0;
-    virtual int    classify(const DataInstance &  data_instance) const = 0;
+    virtual double response(const DataRow & data_instance) const = 0;
+    virtual int    classify(const DataRow & data_instance) const = 0;
+
+    // Called before a series of trainings on the same dataset (e.g. boosting rounds), so that
+    // the classifier caches in the dataset what they can share (e.g. CacheSortedFeatureIndex),
+    // computing it with 'nthreads' threads (one per core if <= 0) like the trainer
+    virtual void   prepareTraining(const Dataset & /*training_dataset*/, int /*nthreads*/) const {}
 
     std::vector<double> response(const Dataset & dataset) const {
 
         std::vector<double> resp;
+        resp.reserve(dataset.size());
 
         for (unsigned int i = 0; i < dataset.size(); i++)
             resp.push_back(response(dataset[i]));
@@ -50,6 +56,7 @@ public:
     std::vector<int> classify(const Dataset & dataset) const {
 
         std::vector<int> classes;
+        classes.reserve(dataset.size());
 
         for (unsigned int i = 0; i < dataset.size(); i++)
             classes.push_back(classify(dataset[i]));
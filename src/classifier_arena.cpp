@@ -0,0 +1,89 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+#include "classifier_arena.h"
+
+using namespace std;
+
+const size_t ClassifierArena::BLOCK_SIZE;
+
+ClassifierArena::ClassifierArena() :
+    current_block(0), used(0)
+{
+}
+
+ClassifierArena::~ClassifierArena()
+{
+    clear();
+}
+
+Classifier * ClassifierArena::adopt(Classifier * classifier)
+{
+    Mark mark = {current_block, used};
+    classifiers.push_back(Entry(classifier, mark, true));
+    return classifier;
+}
+
+void ClassifierArena::truncate(size_t count)
+{
+    if (count >= classifiers.size())
+        return;
+
+    // in reverse order of creation, the memory of the first one destroyed is free again
+    for (size_t i = classifiers.size(); i-- > count; )
+    {
+        if (classifiers[i].adopted)
+            delete classifiers[i].classifier;
+        else
+            classifiers[i].classifier->~Classifier();
+    }
+
+    current_block = classifiers[count].mark.block;
+    used = classifiers[count].mark.offset;
+    classifiers.erase(classifiers.begin() + count, classifiers.end());
+}
+
+ClassifierArena::Mark ClassifierArena::allocate(size_t size, size_t alignment)
+{
+    // the blocks are allocated with new[], aligned for any fundamental type
+    assert(alignment <= alignof(max_align_t));
+    size_t offset = (used + alignment - 1) / alignment * alignment;
+
+    if (blocks.empty() || offset + size > block_sizes[current_block])
+    {
+        // next block, if it is large enough, else a new one
+        size_t next = blocks.empty() ? 0 : current_block + 1;
+        if (next == blocks.size() || size > block_sizes[next])
+        {
+            blocks.insert(blocks.begin() + next, unique_ptr<char[]>(new char[max(size, BLOCK_SIZE)]));
+            block_sizes.insert(block_sizes.begin() + next, max(size, BLOCK_SIZE));
+        }
+
+        current_block = next;
+        offset = 0;
+    }
+
+    Mark mark = {current_block, offset};
+    used = offset + size;
+    return mark;
+}
@@ -0,0 +1,104 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLASSIFIER_ARENA_H_
+#define CLASSIFIER_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "classifier.h"
+
+/// Owns a sequence of classifiers (e.g. the weak learners of a model). Those created by the
+/// arena are constructed next to each other in large blocks of memory, without an allocation
+/// each, which also keeps them close in the cache when they are evaluated in turn.
+/// Classifiers allocated elsewhere with new can be adopted. All are destroyed with the arena.
+class ClassifierArena
+{
+public:
+
+    ClassifierArena();
+    ~ClassifierArena();
+
+    size_t size() const { return classifiers.size(); }
+    bool empty() const { return classifiers.empty(); }
+
+    Classifier * operator [](size_t index) const
+    {
+        return classifiers[index].classifier;
+    }
+
+    // appends a T constructed in the arena with the given arguments
+    template <class T, class... Args>
+    T * create(Args &&... args)
+    {
+        Mark mark = allocate(sizeof(T), alignof(T));
+        T * classifier = new (blocks[mark.block].get() + mark.offset) T(std::forward<Args>(args)...);
+
+        classifiers.push_back(Entry(classifier, mark, false));
+        return classifier;
+    }
+
+    // appends 'classifier', allocated with new, which the arena deletes
+    Classifier * adopt(Classifier * classifier);
+
+    // destroys the classifiers from index 'count' on; their memory is reused by the next ones
+    void truncate(size_t count);
+    void clear() { truncate(0); }
+
+private:
+
+    // not copyable
+    ClassifierArena(const ClassifierArena &);
+    ClassifierArena & operator=(const ClassifierArena &);
+
+    // position in the blocks before a classifier was created
+    struct Mark
+    {
+        size_t block, offset;
+    };
+
+    struct Entry
+    {
+        Entry(Classifier * classifier, Mark mark, bool adopted) :
+            classifier(classifier), mark(mark), adopted(adopted)
+        {
+        }
+
+        Classifier * classifier;
+        Mark mark;
+        bool adopted;
+    };
+
+    // room for 'size' bytes aligned on 'alignment', at blocks[block] + offset of the result
+    Mark allocate(size_t size, size_t alignment);
+
+    static const size_t BLOCK_SIZE = 16384;
+
+    std::vector< std::unique_ptr<char[]> > blocks;
+    std::vector<size_t> block_sizes;
+    size_t current_block, used;     // next free byte is at blocks[current_block] + used
+
+    std::vector<Entry> classifiers;
+};
+
+#endif  // CLASSIFIER_ARENA_H_
@@ -25,8 +25,20 @@
 class ClassifierFactory {
 
 public:
+    virtual ~ClassifierFactory() {}
+
     virtual Classifier * createRandomInstance() const = 0;
 
+    // New random instance in place of 'recycled', an instance created by this factory that is no
+    // longer used. The default deletes it and creates another, which allocates one classifier per
+    // boosting trial; factories should instead reinitialize it and return it, so that trials do not
+    // allocate (see RandomThresholdLearnerFactory).
+    virtual Classifier * recycleRandomInstance(Classifier * recycled) const
+    {
+        delete recycled;
+        return createRandomInstance();
+    }
+
 };
 
 #endif
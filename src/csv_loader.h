@@ -20,6 +20,11 @@
 #ifndef CSV_LOADER_H_
 #define CSV_LOADER_H_
 
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <sstream>
@@ -28,13 +33,16 @@
 #include <vector>
 
 #include "dataset.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
 
 // Load a Dataset from a CSV file. The first row is treated as a header and
 // skipped. All columns except the last are parsed as numeric features using
 // std::stod; malformed values will cause std::stod to throw std::invalid_argument
 // or std::out_of_range, which propagate to the caller. The last column is treated
 // as the class label: numeric strings are parsed as integers, and non-numeric
-// strings are mapped to sequential integers starting from 0.
+// strings are mapped to sequential integers starting from 0. Rows must all have
+// the same number of columns, otherwise std::runtime_error is thrown.
 inline Dataset LoadCsvDataset(const std::string &filename) {
     std::ifstream file(filename);
     if (!file.is_open()) {
@@ -46,15 +54,21 @@ inline Dataset LoadCsvDataset(const std::string &filename) {
     int next_label = 0;
     std::string line;
 
+    // Buffers reused for every row, so parsing a row does not allocate.
+    std::istringstream ss;
+    std::string token;
+    std::vector<std::string> tokens;
+    DataInstance sample;
+
     // Skip header row
     std::getline(file, line);
 
     while (std::getline(file, line)) {
         if (line.empty()) continue;
 
-        std::istringstream ss(line);
-        std::string token;
-        std::vector<std::string> tokens;
+        ss.str(line);
+        ss.clear();
+        tokens.clear();
 
         while (std::getline(ss, token, ',')) {
             tokens.push_back(token);
@@ -62,11 +76,15 @@ inline Dataset LoadCsvDataset(const std::string &filename) {
 
         if (tokens.size() < 2) continue;
 
-        DataInstance sample;
+        sample.clear();
         for (size_t i = 0; i + 1 < tokens.size(); ++i) {
             sample.push_back(std::stod(tokens[i]));
         }
 
+        if (dataset.size() > 0 && sample.size() != dataset.dimension()) {
+            throw std::runtime_error("Inconsistent number of columns in: " + filename);
+        }
+
         const std::string &label_str = tokens.back();
         int label;
         try {
@@ -89,4 +107,343 @@ inline Dataset LoadCsvDataset(const std::string &filename) {
     return dataset;
 }
 
+// Parses a CSV field as std::stod would (same result, same exceptions) but
+// without depending on the locale for the common forms "[-]digits[.digits][e[-]digits]".
+// Other forms (hexadecimal, inf, nan, long mantissas...) go through std::strtod.
+inline double ParseCsvDouble(const char *begin, const char *end) {
+    // powers of ten that are exactly representable as doubles
+    static const double exact_powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                          1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                          1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *p = begin;
+    bool negative = (p != end && *p == '-');
+    if (p != end && (*p == '-' || *p == '+')) ++p;
+
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && *p >= '0' && *p <= '9'; ++p, ++digits, --exponent) {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+    if (digits > 0 && p != end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negative_exponent = (q != end && *q == '-');
+        if (q != end && (*q == '-' || *q == '+')) ++q;
+        int explicit_exponent = 0;
+        const char *exponent_digits = q;
+        for (; q != end && *q >= '0' && *q <= '9' && explicit_exponent < 1000; ++q) {
+            explicit_exponent = explicit_exponent * 10 + (*q - '0');
+        }
+        if (q != exponent_digits) {
+            exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            p = q;
+        }
+    }
+
+    // exact when the mantissa and the power of ten are both representable
+    if (p == end && digits > 0 && digits <= 15 && exponent >= -22 && exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        value = (exponent < 0) ? value / exact_powers[-exponent] : value * exact_powers[exponent];
+        return negative ? -value : value;
+    }
+
+    std::string field(begin, end);
+    char *parsed_end;
+    errno = 0;
+    double value = std::strtod(field.c_str(), &parsed_end);
+    if (parsed_end == field.c_str()) {
+        throw std::invalid_argument("stod");
+    }
+    if (errno == ERANGE) {
+        throw std::out_of_range("stod");
+    }
+    return value;
+}
+
+// Parses a CSV label as std::stoi would. Returns false where std::stoi would
+// throw, i.e. when the label has to be mapped as a string.
+inline bool ParseCsvIntLabel(const char *begin, const char *end, int *out_label) {
+    const char *p = begin;
+    while (p != end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) ++p;
+
+    bool negative = (p != end && *p == '-');
+    if (p != end && (*p == '-' || *p == '+')) ++p;
+
+    const char *digits = p;
+    long long value = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+        value = value * 10 + (*p - '0');
+        if (value > 2147483648LL) return false;  // out of range of int
+    }
+    if (p == digits) return false;
+
+    value = negative ? -value : value;
+    if (value > 2147483647LL) return false;
+
+    *out_label = static_cast<int>(value);
+    return true;
+}
+
+// Rows parsed from one chunk of a CSV file by LoadCsvDatasetParallel.
+struct CsvChunk {
+    size_t dim;
+    std::vector<double> values;  // row-major
+    std::vector<int> labels;     // string labels hold their index in string_labels
+    std::vector<size_t> string_label_rows;
+    std::vector<std::string> string_labels;  // in order of first appearance in the chunk
+};
+
+// Splits the line [begin, end) at commas the way std::getline(..., ',') does, i.e. there
+// is no empty field after a trailing comma, and stores where each field ends.
+inline void SplitCsvFields(const char *begin, const char *end,
+                           std::vector<const char *> *field_ends) {
+    field_ends->clear();
+    for (const char *p = begin; p < end;) {
+        const char *comma = static_cast<const char *>(std::memchr(p, ',', end - p));
+        if (comma == nullptr) comma = end;
+        field_ends->push_back(comma);
+        p = comma + 1;
+    }
+}
+
+// Parses the complete lines in [begin, end) into 'chunk', applying the rules of LoadCsvDataset.
+inline void ParseCsvChunk(const char *begin, const char *end, const std::string &filename,
+                          CsvChunk *chunk) {
+    std::map<std::string, int> local_labels;
+    std::vector<const char *> field_ends;
+    std::string label_str;
+
+    chunk->dim = 0;
+
+    for (const char *line = begin; line < end;) {
+        const char *line_end = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        if (line_end == nullptr) line_end = end;
+
+        SplitCsvFields(line, line_end, &field_ends);
+
+        if (field_ends.size() >= 2) {
+            size_t dim = field_ends.size() - 1;
+            if (chunk->labels.empty()) {
+                chunk->dim = dim;
+            } else if (dim != chunk->dim) {
+                throw std::runtime_error("Inconsistent number of columns in: " + filename);
+            }
+
+            const char *field = line;
+            for (size_t i = 0; i < dim; ++i) {
+                chunk->values.push_back(ParseCsvDouble(field, field_ends[i]));
+                field = field_ends[i] + 1;
+            }
+
+            int label;
+            if (!ParseCsvIntLabel(field, field_ends[dim], &label)) {
+                label_str.assign(field, field_ends[dim]);
+                std::map<std::string, int>::iterator it = local_labels.find(label_str);
+                if (it == local_labels.end()) {
+                    int local_id = static_cast<int>(chunk->string_labels.size());
+                    it = local_labels.insert(std::make_pair(label_str, local_id)).first;
+                    chunk->string_labels.push_back(label_str);
+                }
+                label = it->second;
+                chunk->string_label_rows.push_back(chunk->labels.size());
+            }
+            chunk->labels.push_back(label);
+        }
+
+        line = line_end + 1;
+    }
+}
+
+// Same as LoadCsvDataset, but the file is mapped into memory, split into chunks of
+// whole lines, and the chunks are parsed by 'nthreads' threads (one per core if <= 0).
+// String labels get the same integers as with LoadCsvDataset: they are numbered in
+// the order they first appear in the file.
+inline Dataset LoadCsvDatasetParallel(const std::string &filename, int nthreads = 0) {
+    MappedFile file(filename);
+    const char *data = file.data();
+    const char *end = data + file.size();
+
+    // Skip header row
+    const char *begin = nullptr;
+    if (file.size() > 0) {
+        begin = static_cast<const char *>(std::memchr(data, '\n', file.size()));
+    }
+    if (begin == nullptr) {
+        return Dataset();
+    }
+    ++begin;
+
+    ThreadPool pool(nthreads);
+
+    // a few chunks per thread to balance the load, but not so small that overhead dominates
+    const size_t min_chunk_bytes = 1 << 20;
+    size_t nchunks = std::min<size_t>(4 * pool.size(), (end - begin) / min_chunk_bytes + 1);
+
+    std::vector<const char *> boundaries(1, begin);
+    for (size_t c = 1; c < nchunks; ++c) {
+        const char *nominal = begin + (end - begin) * c / nchunks;
+        if (nominal < boundaries.back()) continue;
+        const char *newline = static_cast<const char *>(std::memchr(nominal, '\n', end - nominal));
+        if (newline == nullptr) break;
+        boundaries.push_back(newline + 1);
+    }
+    boundaries.push_back(end);
+
+    std::vector<CsvChunk> chunks(boundaries.size() - 1);
+    pool.run(chunks.size(), [&](size_t c, int) {
+        ParseCsvChunk(boundaries[c], boundaries[c + 1], filename, &chunks[c]);
+    });
+
+    // merge in file order, numbering string labels by first appearance
+    size_t total = 0, dim = 0;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        if (chunks[c].labels.empty()) continue;
+        if (total > 0 && chunks[c].dim != dim) {
+            throw std::runtime_error("Inconsistent number of columns in: " + filename);
+        }
+        dim = chunks[c].dim;
+        total += chunks[c].labels.size();
+    }
+
+    Dataset dataset;
+    dataset.reserve(total);
+    std::map<std::string, int> label_map;
+    int next_label = 0;
+    std::vector<int> global_ids;
+
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        CsvChunk &chunk = chunks[c];
+
+        global_ids.clear();
+        for (size_t s = 0; s < chunk.string_labels.size(); ++s) {
+            std::map<std::string, int>::iterator it = label_map.find(chunk.string_labels[s]);
+            if (it == label_map.end()) {
+                it = label_map.insert(std::make_pair(chunk.string_labels[s], next_label++)).first;
+            }
+            global_ids.push_back(it->second);
+        }
+        for (size_t r = 0; r < chunk.string_label_rows.size(); ++r) {
+            int &label = chunk.labels[chunk.string_label_rows[r]];
+            label = global_ids[label];
+        }
+
+        for (size_t i = 0; i < chunk.labels.size(); ++i) {
+            dataset.add(DataRow(&chunk.values[i * dim], dim, 1), chunk.labels[i]);
+        }
+
+        // release the chunk as soon as it is merged to limit peak memory
+        std::vector<double>().swap(chunk.values);
+    }
+
+    return dataset;
+}
+
+// Reads a CSV file in batches of rows, so that files larger than memory can be
+// processed (converted, subsampled, fed to an online learner...) with a fixed memory
+// footprint. Rows are parsed with the same rules as LoadCsvDataset, and string labels
+// get the same integers as they would get if the whole file was loaded at once.
+//
+//   CsvBatchReader reader("data.csv", 10000);
+//   Dataset batch;
+//   while (reader.next(&batch)) { ... }
+class CsvBatchReader {
+public:
+    // Batches hold at most 'batch_size' rows. If 'max_batch_bytes' is not 0, the batch
+    // size is further reduced so that the samples and labels of one batch take at most
+    // that many bytes (but a batch always has room for at least one row).
+    // Throws std::runtime_error if the file can not be opened.
+    CsvBatchReader(const std::string &filename, size_t batch_size, size_t max_batch_bytes = 0)
+        : file(filename.c_str()),
+          filename(filename),
+          batch_size(batch_size),
+          max_batch_bytes(max_batch_bytes),
+          dim(0),
+          rows_read(0),
+          next_label(0) {
+        assert(batch_size > 0);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+
+        // Skip header row
+        std::getline(file, line);
+    }
+
+    // Replaces the content of 'batch' with the next rows of the file, reusing its storage.
+    // Returns false, with 'batch' empty, once the whole file has been read.
+    bool next(Dataset *batch) {
+        batch->clear();
+
+        while (batch->size() < batch_size && std::getline(file, line)) {
+            const char *begin = line.data();
+            const char *end = begin + line.size();
+            SplitCsvFields(begin, end, &field_ends);
+            if (field_ends.size() < 2) continue;
+
+            if (rows_read == 0) {
+                startFirstBatch(field_ends.size() - 1, batch);
+            } else if (field_ends.size() - 1 != dim) {
+                throw std::runtime_error("Inconsistent number of columns in: " + filename);
+            }
+
+            const char *field = begin;
+            for (size_t i = 0; i < dim; ++i) {
+                sample[i] = ParseCsvDouble(field, field_ends[i]);
+                field = field_ends[i] + 1;
+            }
+
+            int label;
+            if (!ParseCsvIntLabel(field, field_ends[dim], &label)) {
+                label_str.assign(field, field_ends[dim]);
+                std::map<std::string, int>::iterator it = label_map.find(label_str);
+                if (it == label_map.end()) {
+                    it = label_map.insert(std::make_pair(label_str, next_label++)).first;
+                }
+                label = it->second;
+            }
+
+            batch->add(sample, label);
+            ++rows_read;
+        }
+
+        return batch->size() > 0;
+    }
+
+    // number of rows returned so far
+    size_t rowsRead() const { return rows_read; }
+
+    // maximum number of rows in a batch (known once the first row has been read)
+    size_t batchSize() const { return batch_size; }
+
+private:
+    // the number of features is known: apply the memory limit and allocate the batch once
+    void startFirstBatch(size_t num_features, Dataset *batch) {
+        dim = num_features;
+        sample.resize(dim);
+
+        if (max_batch_bytes > 0) {
+            size_t row_bytes = dim * sizeof(double) + sizeof(int);
+            batch_size = std::max<size_t>(1, std::min(batch_size, max_batch_bytes / row_bytes));
+        }
+        batch->reserve(batch_size);
+    }
+
+    std::ifstream file;
+    std::string filename;
+    size_t batch_size, max_batch_bytes, dim, rows_read;
+
+    std::map<std::string, int> label_map;
+    int next_label;
+
+    // buffers reused for every row
+    std::string line, label_str;
+    std::vector<const char *> field_ends;
+    DataInstance sample;
+};
+
 #endif  // CSV_LOADER_H_
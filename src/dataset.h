@@ -18,6 +18,10 @@
 */
 
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -26,37 +30,362 @@
 
 #define DataInstance std::vector<double>
 
+class BinnedFeatures;
+class SortedFeatureIndex;
+
+/// Read-only view of one sample of a Dataset (no copy is made).
+/// Consecutive features are 'stride' doubles apart in memory.
+class DataRow {
+
+public:
+
+    DataRow(const double * values, size_t dim, size_t stride) :
+        values(values), dim(dim), stride(stride)
+    {
+    }
+
+    // allows passing a DataInstance wherever a DataRow is expected
+    DataRow(const DataInstance & sample) :
+        values(sample.data()), dim(sample.size()), stride(1)
+    {
+    }
+
+    size_t size() const
+    {
+        return dim;
+    }
+
+    // true if the features are one array (the rows of a row-major dataset)
+    bool isContiguous() const
+    {
+        return stride == 1;
+    }
+
+    // only meaningful if isContiguous()
+    const double * data() const
+    {
+        return values;
+    }
+
+    double operator [](size_t feature_index) const
+    {
+        return values[feature_index * stride];
+    }
+
+private:
+
+    const double * values;
+    size_t dim, stride;
+};
+
+/// Read-only view of one feature across all samples of a Dataset.
+/// It is contiguous (stride 1) when the dataset is stored column-major.
+class FeatureColumn {
+
+public:
+
+    FeatureColumn(const double * values, size_t nsamples, size_t stride) :
+        values(values), nsamples(nsamples), stride(stride)
+    {
+    }
+
+    size_t size() const
+    {
+        return nsamples;
+    }
+
+    bool isContiguous() const
+    {
+        return stride == 1;
+    }
+
+    // only meaningful if isContiguous()
+    const double * data() const
+    {
+        return values;
+    }
+
+    double operator [](size_t sample_index) const
+    {
+        return values[sample_index * stride];
+    }
+
+private:
+
+    const double * values;
+    size_t nsamples, stride;
+};
+
 class Dataset {
-    
-public: 
-    
+
+public:
+
+    /// ROW_MAJOR keeps the features of a sample together, COLUMN_MAJOR keeps
+    /// each feature in one contiguous array (faster per-feature sweeps when training)
+    enum Layout { ROW_MAJOR, COLUMN_MAJOR };
+
+    Dataset() :
+        storage_layout(ROW_MAJOR), nsamples(0), dim(0), column_capacity(0), reserved(0),
+        external_values(nullptr), external_labels(nullptr)
+    {
+    }
+
+    explicit Dataset(Layout layout) :
+        storage_layout(layout), nsamples(0), dim(0), column_capacity(0), reserved(0),
+        external_values(nullptr), external_labels(nullptr)
+    {
+    }
+
+    // Dataset over samples and labels stored elsewhere (e.g. in a memory-mapped file),
+    // which are used in place, without a copy. 'owner' keeps that storage alive for as
+    // long as this dataset (or a copy of it) exists. The storage is copied on the first add().
+    Dataset(Layout layout, size_t nsamples, size_t dim, const double * values, const int * labels,
+            const std::shared_ptr<const void> & owner) :
+        storage_layout(layout), nsamples(nsamples), dim(dim), column_capacity(nsamples),
+        reserved(0), external_values(values), external_labels(labels), external_owner(owner)
+    {
+    }
+
+    // copy of 'other' stored with the given layout
+    Dataset(const Dataset & other, Layout layout) :
+        storage_layout(layout), nsamples(0), dim(0), column_capacity(0), reserved(0),
+        external_values(nullptr), external_labels(nullptr)
+    {
+        reserve(other.size());
+        for (size_t i = 0; i < other.size(); i++)
+            add(other[i], other.getLabelAt(i));
+    }
+
     size_t size() const
     {
-        return data.size();
+        return nsamples;
+    }
+
+    size_t dimension() const
+    {
+        return dim;
+    }
+
+    Layout layout() const
+    {
+        return storage_layout;
     }
-    
-    const DataInstance & operator [](unsigned int sample_index) const
+
+    DataRow operator [](size_t sample_index) const
     {
-        return data[sample_index];
+        assert(sample_index < nsamples);
+
+        if (storage_layout == COLUMN_MAJOR)
+            return DataRow(valueData() + sample_index, dim, column_capacity);
+
+        return DataRow(valueData() + sample_index * dim, dim, 1);
     }
 
-    void add(DataInstance & sample, int label)
+    FeatureColumn column(size_t feature_index) const
     {
-        data.push_back(sample);
+        assert(feature_index < dim);
+
+        if (storage_layout == COLUMN_MAJOR)
+            return FeatureColumn(valueData() + feature_index * column_capacity, nsamples, 1);
+
+        return FeatureColumn(valueData() + feature_index, nsamples, dim);
+    }
+
+    void add(const DataRow & sample, int label)
+    {
+        // 'sample' may be a view into the external storage, which must outlive this call
+        std::shared_ptr<const void> external_storage = external_owner;
+        if (isExternal())
+            copyExternalStorage();
+
+        sorted_index.reset();
+        binned_features.reset();
+
+        if (nsamples == 0)
+        {
+            if (sample.size() != dim)
+            {
+                // storage laid out for another dimension can not be reused
+                values.clear();
+                column_capacity = 0;
+                dim = sample.size();
+            }
+            reserveValues(reserved);
+        }
+
+        assert(sample.size() == dim);
+
+        if (isFull())
+        {
+            // 'sample' may be a view into this dataset, which growing the buffer would invalidate
+            DataInstance copy(dim);
+            for (size_t d = 0; d < dim; d++)
+                copy[d] = sample[d];
+
+            reserveValues(std::max<size_t>(16, 2 * nsamples));
+            append(copy);
+        }
+        else
+            append(sample);
+
         labels.push_back(label);
+        nsamples++;
+    }
+
+    // the dimension may not be known yet, in which case the request is applied on the first add
+    void reserve(size_t capacity)
+    {
+        // the storage must be owned to grow
+        if (isExternal())
+            copyExternalStorage();
+
+        reserved = std::max(reserved, capacity);
+
+        if (nsamples > 0)
+            reserveValues(capacity);
+
+        labels.reserve(capacity);
+    }
+
+    // removes all samples but keeps the allocated storage, so the dataset can be refilled cheaply
+    void clear()
+    {
+        if (isExternal())
+        {
+            external_values = nullptr;
+            external_labels = nullptr;
+            external_owner.reset();
+            column_capacity = 0;
+        }
+
+        // column-major storage stays laid out for the current capacity
+        if (storage_layout == ROW_MAJOR)
+            values.clear();
+
+        labels.clear();
+        nsamples = 0;
+        sorted_index.reset();
+        binned_features.reset();
     }
 
     int getLabelAt(size_t sample_index) const
     {
-        return labels[sample_index];
+        return external_labels != nullptr ? external_labels[sample_index] : labels[sample_index];
+    }
+
+    // labels of all the samples, contiguous
+    const int * labelData() const
+    {
+        return external_labels != nullptr ? external_labels : labels.data();
+    }
+
+    // Samples sorted along each feature, shared by all the learners trained on this dataset.
+    // Null until computed with CacheSortedFeatureIndex(); dropped when the dataset is modified.
+    const SortedFeatureIndex * sortedIndex() const
+    {
+        return sorted_index.get();
+    }
+
+    // Features quantized for histogram-based split search, shared like the sorted index.
+    // Null until computed with CacheBinnedFeatures(); dropped when the dataset is modified.
+    const BinnedFeatures * binnedFeatures() const
+    {
+        return binned_features.get();
+    }
+
+    // true if the samples are not owned by this dataset (see the external storage constructor)
+    bool isExternal() const
+    {
+        return external_values != nullptr;
     }
 
 
 protected:
-    
-    std::vector< DataInstance > data;
+
+    const double * valueData() const
+    {
+        return external_values != nullptr ? external_values : values.data();
+    }
+
+    void copyExternalStorage()
+    {
+        values.assign(external_values, external_values + nsamples * dim);
+        labels.assign(external_labels, external_labels + nsamples);
+        external_values = nullptr;
+        external_labels = nullptr;
+        external_owner.reset();
+    }
+
+    bool isFull() const
+    {
+        if (storage_layout == COLUMN_MAJOR)
+            return nsamples == column_capacity;
+
+        return values.size() + dim > values.capacity();
+    }
+
+    // writes 'sample' after the last one; there must be room for it
+    void append(const DataRow & sample)
+    {
+        if (storage_layout == COLUMN_MAJOR)
+        {
+            for (size_t d = 0; d < dim; d++)
+                values[d * column_capacity + nsamples] = sample[d];
+        }
+        else
+        {
+            // all samples share one buffer, so adding one does not allocate a vector of its own
+            values.resize(values.size() + dim);
+            double * dest = &values[nsamples * dim];
+            for (size_t d = 0; d < dim; d++)
+                dest[d] = sample[d];
+        }
+    }
+
+    void reserveValues(size_t capacity)
+    {
+        if (storage_layout == ROW_MAJOR)
+            values.reserve(capacity * dim);
+        else if (capacity > column_capacity)
+            growColumns(capacity);
+    }
+
+    // re-lays out the columns so that each one has room for 'capacity' samples
+    void growColumns(size_t capacity)
+    {
+        std::vector<double> grown(dim * capacity);
+
+        for (size_t d = 0; d < dim; d++)
+            std::copy(values.begin() + d * column_capacity,
+                      values.begin() + d * column_capacity + nsamples,
+                      grown.begin() + d * capacity);
+
+        values.swap(grown);
+        column_capacity = capacity;
+    }
+
+    Layout storage_layout;
+    size_t nsamples, dim;
+
+    // one buffer holding all samples:
+    //   ROW_MAJOR:    feature d of sample i is at values[i * dim + d]
+    //   COLUMN_MAJOR: feature d of sample i is at values[d * column_capacity + i]
+    std::vector< double > values;
+    size_t column_capacity, reserved;
+
     std::vector< int > labels;
 
+    // storage not owned by this dataset, used instead of 'values' and 'labels' when set
+    const double * external_values;
+    const int * external_labels;
+    std::shared_ptr<const void> external_owner;
+
+    // derived from the samples, so they can be cached in a const dataset
+    mutable std::shared_ptr<const SortedFeatureIndex> sorted_index;
+    mutable std::shared_ptr<const BinnedFeatures> binned_features;
+    friend const SortedFeatureIndex & CacheSortedFeatureIndex(const Dataset & dataset, int nthreads);
+    friend const BinnedFeatures & CacheBinnedFeatures(const Dataset & dataset, int nthreads);
+
 };
 
 #endif
@@ -17,8 +17,17 @@
  *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define EXPONENTIAL_LOSS_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 #include "dataset.h"
 #include "exponential_loss.h"
@@ -26,6 +35,337 @@
 
 using namespace std;
 
+namespace
+{
+
+// Compensated (Kahan) sums of sample losses in three buckets, one per agreement between label
+// and direction (-1, 0 or 1), so that rounding errors do not grow with the number of samples.
+class AgreementSums
+{
+public:
+
+    AgreementSums()
+    {
+        for (int k = 0; k < 3; k++)
+            sums[k] = compensations[k] = 0.0;
+    }
+
+    // bucket 0, 1 and 2 hold agreements -1, 0 and 1
+    void add(int bucket, double value)
+    {
+        double y = value - compensations[bucket];
+        double t = sums[bucket] + y;
+        compensations[bucket] = (t - sums[bucket]) - y;
+        sums[bucket] = t;
+    }
+
+    // The bucket is indexed by the agreement rather than chosen by a data-dependent branch.
+    // Other agreements come from labels or directions that the callers reject; they are
+    // dropped, as in the vector kernels, rather than written outside the sums.
+    void addByAgreement(int agreement, double loss)
+    {
+        if (agreement >= -1 && agreement <= 1)
+            add(agreement + 1, loss);
+    }
+
+    void optimalStep(double * out_optimal_step, double * out_minimum_loss) const
+    {
+        double W_minus = sums[0], W_0 = sums[1], W_plus = sums[2];
+
+        *out_minimum_loss = W_0 + 2 * sqrt(W_minus * W_plus);
+        *out_optimal_step = 0.5 * log(W_plus / W_minus);        // the same as log(sqrt(W_plus/W_minus))
+    }
+
+private:
+
+    double sums[3], compensations[3];
+};
+
+}
+
+// Kernels computing out[i] = weights[i] * exp(-labels[i] * responses[i]) for i in [0, n),
+// times -labels[i] if 'gradient' is set.
+typedef void (*ExpLossKernel)(size_t n, const int * labels, const double * weights,
+                              const double * responses, bool gradient, double * out);
+
+// Kernels adding losses[i] to the bucket of labels[i] * direction[i] for i in [0, n).
+// Labels and directions are -1, 0 or 1.
+typedef void (*AgreementSumsKernel)(size_t n, const int8_t * labels, const int8_t * direction,
+                                    const double * losses, AgreementSums & sums);
+
+static void ExpLossScalar(size_t n, const int * labels, const double * weights,
+                          const double * responses, bool gradient, double * out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        double factor = gradient ? weights[i] * -labels[i] : weights[i];
+        out[i] = factor * exp(-labels[i] * responses[i]);
+    }
+}
+
+static void AgreementSumsScalar(size_t n, const int8_t * labels, const int8_t * direction,
+                                const double * losses, AgreementSums & sums)
+{
+    // the direction times the sign of the label, as the sign instruction of the vector kernels
+    for (size_t i = 0; i < n; i++)
+        sums.addByAgreement(direction[i] * ((labels[i] > 0) - (labels[i] < 0)), losses[i]);
+}
+
+// throws std::invalid_argument if a label of 'dataset' is not -1, 0 or 1
+static void CheckLabels(const Dataset & dataset)
+{
+    const int * labels = dataset.labelData();
+    for (size_t i = 0; i < dataset.size(); i++)
+        if (labels[i] < -1 || labels[i] > 1)
+            throw invalid_argument("ExponentialLoss: label " + to_string(labels[i]) + " of sample " +
+                                   to_string(i) + " is not -1, 0 or 1");
+}
+
+#ifdef EXPONENTIAL_LOSS_X86_KERNELS
+
+// The vector exp reduces x = n * ln(2) + r, with |r| <= ln(2) / 2, and evaluates the Taylor
+// polynomial of exp(r), which is within one ulp of std::exp (see setSimdLevel). Arguments outside
+// [EXP_MIN_ARG, EXP_MAX_ARG] and NaNs are left to std::exp, so that overflow and subnormal
+// results are the same as in the scalar kernel.
+static const double EXP_MIN_ARG = -708.0, EXP_MAX_ARG = 709.0;
+static const double LOG2E = 1.4426950408889634;
+static const double LN2_HI = 6.93147180369123816490e-01;    // n * LN2_HI is exact for |n| < 2^20
+static const double LN2_LO = 1.90821492927058770002e-10;
+static const double ROUNDING_SHIFT = 6755399441055744.0;     // 1.5 * 2^52, adding it rounds to an integer
+
+static const int EXP_DEGREE = 13;
+static const double EXP_COEFFICIENTS[EXP_DEGREE + 1] =
+{
+    1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+    1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800.0
+};
+
+__attribute__((target("avx2")))
+static inline __m256d ExpAvx2(__m256d x)
+{
+    __m256d shifted = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)), _mm256_set1_pd(ROUNDING_SHIFT));
+    __m256d n = _mm256_sub_pd(shifted, _mm256_set1_pd(ROUNDING_SHIFT));
+    __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(LN2_HI)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(n, _mm256_set1_pd(LN2_LO)));
+
+    __m256d p = _mm256_set1_pd(EXP_COEFFICIENTS[EXP_DEGREE]);
+    for (int k = EXP_DEGREE - 1; k >= 0; k--)
+        p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(EXP_COEFFICIENTS[k]));
+
+    // 2^n from its exponent bits; the low bits of 'shifted' hold n
+    __m256i bits = _mm256_add_epi64(_mm256_castpd_si256(shifted), _mm256_set1_epi64x(1023));
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52)));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d ExpAvx512(__m512d x)
+{
+    __m512d shifted = _mm512_add_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)), _mm512_set1_pd(ROUNDING_SHIFT));
+    __m512d n = _mm512_sub_pd(shifted, _mm512_set1_pd(ROUNDING_SHIFT));
+    __m512d r = _mm512_sub_pd(x, _mm512_mul_pd(n, _mm512_set1_pd(LN2_HI)));
+    r = _mm512_sub_pd(r, _mm512_mul_pd(n, _mm512_set1_pd(LN2_LO)));
+
+    __m512d p = _mm512_set1_pd(EXP_COEFFICIENTS[EXP_DEGREE]);
+    for (int k = EXP_DEGREE - 1; k >= 0; k--)
+        p = _mm512_add_pd(_mm512_mul_pd(p, r), _mm512_set1_pd(EXP_COEFFICIENTS[k]));
+
+    __m512i bits = _mm512_add_epi64(_mm512_castpd_si512(shifted), _mm512_set1_epi64(1023));
+    return _mm512_mul_pd(p, _mm512_castsi512_pd(_mm512_maskz_slli_epi64(0xFF, bits, 52)));
+}
+
+__attribute__((target("avx2")))
+static void ExpLossAvx2(size_t n, const int * labels, const double * weights,
+                        const double * responses, bool gradient, double * out)
+{
+    const __m256d min_arg = _mm256_set1_pd(EXP_MIN_ARG), max_arg = _mm256_set1_pd(EXP_MAX_ARG);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i neg_labels = _mm_sub_epi32(_mm_setzero_si128(), _mm_loadu_si128((const __m128i *) (labels + i)));
+        __m256d factor = _mm256_loadu_pd(weights + i);
+        __m256d x = _mm256_mul_pd(_mm256_cvtepi32_pd(neg_labels), _mm256_loadu_pd(responses + i));
+        if (gradient)
+            factor = _mm256_mul_pd(factor, _mm256_cvtepi32_pd(neg_labels));
+
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(factor, ExpAvx2(x)));
+
+        __m256d in_range = _mm256_and_pd(_mm256_cmp_pd(x, min_arg, _CMP_GE_OQ), _mm256_cmp_pd(x, max_arg, _CMP_LE_OQ));
+        if (_mm256_movemask_pd(in_range) != 0xF)
+            ExpLossScalar(4, labels + i, weights + i, responses + i, gradient, out + i);
+    }
+
+    ExpLossScalar(n - i, labels + i, weights + i, responses + i, gradient, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void ExpLossAvx512(size_t n, const int * labels, const double * weights,
+                          const double * responses, bool gradient, double * out)
+{
+    const __m512d min_arg = _mm512_set1_pd(EXP_MIN_ARG), max_arg = _mm512_set1_pd(EXP_MAX_ARG);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i neg_labels = _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_loadu_si256((const __m256i *) (labels + i)));
+        __m512d factor = _mm512_loadu_pd(weights + i);
+        // the zero-masked forms of the conversions, whose unmasked forms start from undefined registers
+        __m512d neg_labels_pd = _mm512_maskz_cvtepi32_pd(0xFF, neg_labels);
+        __m512d x = _mm512_mul_pd(neg_labels_pd, _mm512_loadu_pd(responses + i));
+        if (gradient)
+            factor = _mm512_mul_pd(factor, neg_labels_pd);
+
+        _mm512_storeu_pd(out + i, _mm512_mul_pd(factor, ExpAvx512(x)));
+
+        __mmask8 in_range = _mm512_cmp_pd_mask(x, min_arg, _CMP_GE_OQ) & _mm512_cmp_pd_mask(x, max_arg, _CMP_LE_OQ);
+        if (in_range != 0xFF)
+            ExpLossScalar(8, labels + i, weights + i, responses + i, gradient, out + i);
+    }
+
+    ExpLossScalar(n - i, labels + i, weights + i, responses + i, gradient, out + i);
+}
+
+__attribute__((target("avx2")))
+static inline void KahanAddAvx2(__m256d & sum, __m256d & compensation, __m256d value)
+{
+    __m256d y = _mm256_sub_pd(value, compensation);
+    __m256d t = _mm256_add_pd(sum, y);
+    compensation = _mm256_sub_pd(_mm256_sub_pd(t, sum), y);
+    sum = t;
+}
+
+__attribute__((target("avx512f")))
+static inline void KahanAddAvx512(__m512d & sum, __m512d & compensation, __m512d value)
+{
+    __m512d y = _mm512_sub_pd(value, compensation);
+    __m512d t = _mm512_add_pd(sum, y);
+    compensation = _mm512_sub_pd(_mm512_sub_pd(t, sum), y);
+    sum = t;
+}
+
+// Both vector kernels keep two sets of accumulators, to hide the latency of the compensated
+// additions, and fold their lanes into 'sums' at the end. Labels are -1, 0 or 1, so the sign
+// instruction multiplies the directions by them.
+
+__attribute__((target("avx2")))
+static void AgreementSumsAvx2(size_t n, const int8_t * labels, const int8_t * direction,
+                              const double * losses, AgreementSums & sums)
+{
+    const __m256i agreements[3] = { _mm256_set1_epi64x(-1), _mm256_setzero_si256(), _mm256_set1_epi64x(1) };
+    __m256d bucket_sums[2][3], compensations[2][3];
+    for (int u = 0; u < 2; u++)
+        for (int k = 0; k < 3; k++)
+            bucket_sums[u][k] = compensations[u][k] = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        for (int u = 0; u < 2; u++)
+        {
+            int32_t packed_labels, packed_direction;
+            memcpy(&packed_labels, labels + i + 4 * u, 4);
+            memcpy(&packed_direction, direction + i + 4 * u, 4);
+            __m256i agreement = _mm256_cvtepi8_epi64(_mm_sign_epi8(_mm_cvtsi32_si128(packed_direction),
+                                                                   _mm_cvtsi32_si128(packed_labels)));
+            __m256d loss = _mm256_loadu_pd(losses + i + 4 * u);
+
+            for (int k = 0; k < 3; k++)
+            {
+                __m256d in_bucket = _mm256_castsi256_pd(_mm256_cmpeq_epi64(agreement, agreements[k]));
+                KahanAddAvx2(bucket_sums[u][k], compensations[u][k], _mm256_and_pd(in_bucket, loss));
+            }
+        }
+    }
+
+    double lanes[4];
+    for (int u = 0; u < 2; u++)
+        for (int k = 0; k < 3; k++)
+        {
+            _mm256_storeu_pd(lanes, bucket_sums[u][k]);
+            for (int l = 0; l < 4; l++)
+                sums.add(k, lanes[l]);
+
+            _mm256_storeu_pd(lanes, compensations[u][k]);
+            for (int l = 0; l < 4; l++)
+                sums.add(k, -lanes[l]);
+        }
+
+    AgreementSumsScalar(n - i, labels + i, direction + i, losses + i, sums);
+}
+
+__attribute__((target("avx512f")))
+static void AgreementSumsAvx512(size_t n, const int8_t * labels, const int8_t * direction,
+                                const double * losses, AgreementSums & sums)
+{
+    const __m512i agreements[3] = { _mm512_set1_epi64(-1), _mm512_setzero_si512(), _mm512_set1_epi64(1) };
+    __m512d bucket_sums[2][3], compensations[2][3];
+    for (int u = 0; u < 2; u++)
+        for (int k = 0; k < 3; k++)
+            bucket_sums[u][k] = compensations[u][k] = _mm512_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        for (int u = 0; u < 2; u++)
+        {
+            __m128i packed_labels = _mm_loadl_epi64((const __m128i *) (labels + i + 8 * u));
+            __m128i packed_direction = _mm_loadl_epi64((const __m128i *) (direction + i + 8 * u));
+            __m512i agreement = _mm512_maskz_cvtepi8_epi64(0xFF, _mm_sign_epi8(packed_direction, packed_labels));
+            __m512d loss = _mm512_loadu_pd(losses + i + 8 * u);
+
+            for (int k = 0; k < 3; k++)
+            {
+                __mmask8 in_bucket = _mm512_cmpeq_epi64_mask(agreement, agreements[k]);
+                KahanAddAvx512(bucket_sums[u][k], compensations[u][k], _mm512_maskz_mov_pd(in_bucket, loss));
+            }
+        }
+    }
+
+    double lanes[8];
+    for (int u = 0; u < 2; u++)
+        for (int k = 0; k < 3; k++)
+        {
+            _mm512_storeu_pd(lanes, bucket_sums[u][k]);
+            for (int l = 0; l < 8; l++)
+                sums.add(k, lanes[l]);
+
+            _mm512_storeu_pd(lanes, compensations[u][k]);
+            for (int l = 0; l < 8; l++)
+                sums.add(k, -lanes[l]);
+        }
+
+    AgreementSumsScalar(n - i, labels + i, direction + i, losses + i, sums);
+}
+
+#endif  // EXPONENTIAL_LOSS_X86_KERNELS
+
+static ExpLossKernel SelectExpLossKernel(SimdLevel level)
+{
+#ifdef EXPONENTIAL_LOSS_X86_KERNELS
+    if (level == SIMD_AVX512)
+        return ExpLossAvx512;
+    if (level == SIMD_AVX2)
+        return ExpLossAvx2;
+#endif
+    return ExpLossScalar;
+}
+
+static AgreementSumsKernel SelectAgreementSumsKernel(SimdLevel level)
+{
+#ifdef EXPONENTIAL_LOSS_X86_KERNELS
+    if (level == SIMD_AVX512)
+        return AgreementSumsAvx512;
+    if (level == SIMD_AVX2)
+        return AgreementSumsAvx2;
+#endif
+    return AgreementSumsScalar;
+}
+
+ExponentialLoss::ExponentialLoss() :
+    simd_level(DetectSimdLevel())
+{
+}
+
 // computes the value of the loss function for a given dataset and responses of a classifier on those samples
 void ExponentialLoss::value( const Dataset & dataset,
                           const vector<double> & data_weights,
@@ -35,12 +375,10 @@ void ExponentialLoss::value( const Dataset & dataset,
     assert(out_loss.size() == responses.size());
     assert(data_weights.size() == dataset.size());
     assert(data_weights.size() == responses.size());
+    CheckLabels(dataset);
 
-    for (size_t i = 0; i < dataset.size(); i++)
-    {
-        out_loss[i] = data_weights[i] * exp(-dataset.getLabelAt(i) * responses[i]);
-    }
-
+    SelectExpLossKernel(simd_level)(dataset.size(), dataset.labelData(), data_weights.data(),
+                                    responses.data(), false, out_loss.data());
 }
 
 // computes the gradient of the loss function (which is a vector with one dimension per sample in the dataset)
@@ -52,12 +390,10 @@ void ExponentialLoss::gradient( const Dataset & dataset,
     assert(out_gradient.size() == responses.size());
     assert(data_weights.size() == dataset.size());
     assert(data_weights.size() == responses.size());
+    CheckLabels(dataset);
 
-    for (size_t i = 0; i < dataset.size(); i++)
-    {
-        out_gradient[i] = data_weights[i] * -dataset.getLabelAt(i) * exp(-dataset.getLabelAt(i) * responses[i]);
-    }
-
+    SelectExpLossKernel(simd_level)(dataset.size(), dataset.labelData(), data_weights.data(),
+                                    responses.data(), true, out_gradient.data());
 }
 
 // computes how far one should move along a given direction in order to minimize the loss the most
@@ -72,31 +408,56 @@ void ExponentialLoss::optimal_step_along_direction(const Dataset & dataset,
     assert(direction.size() == responses.size());
     assert(data_weights.size() == dataset.size());
     assert(data_weights.size() == responses.size());
+    CheckLabels(dataset);
 
-
-    double W_0 = 0.0, W_minus = 0.0, W_plus = 0.0;
+    AgreementSums sums;
 
     for (size_t i = 0; i < dataset.size(); i++)
     {
         double val = data_weights[i] * exp(-dataset.getLabelAt(i) * responses[i]);
+        sums.addByAgreement(direction[i] * dataset.getLabelAt(i), val);
+    }
 
-        switch ( direction[i]*dataset.getLabelAt(i))
-        {
-        case 0:
-            W_0 += val;
-            break;
-        case -1:
-            W_minus += val;
-            break;
-        case 1:
-            W_plus += val;
-            break;
-        default:
-            abort();
+    sums.optimalStep(out_optimal_step, out_minimum_loss);
+}
 
-        }
-    }
+// same, from the loss of each sample at the current responses
+void ExponentialLoss::optimal_step_along_direction(const Dataset & dataset,
+        const vector<double> & sample_losses,
+        const vector<int> & direction,
+        double * out_optimal_step,
+        double * out_minimum_loss) const
+{
+    assert(direction.size() == dataset.size());
+    assert(sample_losses.size() == dataset.size());
+    CheckLabels(dataset);
+
+    AgreementSums sums;
+
+    for (size_t i = 0; i < dataset.size(); i++)
+        sums.addByAgreement(direction[i] * dataset.getLabelAt(i), sample_losses[i]);
+
+    sums.optimalStep(out_optimal_step, out_minimum_loss);
+}
+
+// same, with packed labels and directions
+void ExponentialLoss::optimal_step_along_direction(const vector<int8_t> & labels,
+        const vector<double> & sample_losses,
+        const vector<int8_t> & direction,
+        double * out_optimal_step,
+        double * out_minimum_loss) const
+{
+    assert(direction.size() == labels.size());
+    assert(sample_losses.size() == labels.size());
 
-    *out_minimum_loss = W_0 + 2 * sqrt(W_minus * W_plus);
-    *out_optimal_step = 0.5 * log(W_plus / W_minus);        // the same as log(sqrt(W_plus/W_minus))
+    AgreementSums sums;
+    SelectAgreementSumsKernel(simd_level)(labels.size(), labels.data(), direction.data(),
+                                          sample_losses.data(), sums);
+
+    sums.optimalStep(out_optimal_step, out_minimum_loss);
+}
+
+void ExponentialLoss::setSimdLevel(SimdLevel level)
+{
+    simd_level = min(level, DetectSimdLevel());
 }
@@ -17,15 +17,25 @@
  *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifndef EXPLOSS
+#define EXPLOSS
+
+#include <cstdint>
 #include <vector>
 
+#include "cpu_features.h"
 #include "dataset.h"
 #include "loss.h"
 
+/// The labels of the datasets must be -1, 0 or 1: the methods taking a dataset throw
+/// std::invalid_argument otherwise. The packed labels are checked by their caller
+/// (BoostedClassifier::train checks them once).
 class ExponentialLoss : Loss
 {
 public:
 
+    ExponentialLoss();
+
     // computes the value of the loss function for a given dataset and responses of a classifier on those samples
     void value( const Dataset & dataset,
                 const std::vector<double> & data_weights,
@@ -47,6 +57,35 @@ public:
                                       double * out_optimal_step,
                                       double * out_minimum_loss) const;
 
+    // Same as optimal_step_along_direction, given the loss of each sample at the current responses
+    // (as computed by value()) instead of the weights and responses. These do not change during a
+    // boosting round, so the exponentials are computed once per round instead of once per direction.
+    void optimal_step_along_direction(const Dataset & dataset,
+                                      const std::vector<double> & sample_losses,
+                                      const std::vector<int> & direction,
+                                      double * out_optimal_step,
+                                      double * out_minimum_loss) const;
+
+    // Same, with the labels and the direction packed as int8 (values -1, 0 or 1). This is the
+    // innermost loop of boosting, so it runs with vector instructions, accumulating each of the
+    // three weight sums with compensated summation.
+    void optimal_step_along_direction(const std::vector<int8_t> & labels,
+                                      const std::vector<double> & sample_losses,
+                                      const std::vector<int8_t> & direction,
+                                      double * out_optimal_step,
+                                      double * out_minimum_loss) const;
+
+    // Highest instruction set used by the kernels (default and maximum: DetectSimdLevel()).
+    // The vector exp is within one ulp of std::exp, which the scalar kernels use, so value() and
+    // gradient() are within two ulps of the scalar ones (a relative error below 4.5e-16), with
+    // the rounding of the product by the weight. Results for a given level do not change from
+    // run to run, but models trained with these losses (e.g. BoostedClassifier) may differ in
+    // the last bits, or in a tied choice, from one level to another.
+    void setSimdLevel(SimdLevel level);
+
 private:
 
-};
\ No newline at end of file
+    SimdLevel simd_level;
+};
+
+#endif
@@ -45,6 +45,17 @@ GaussianLearner::GaussianLearner(unsigned int feature_index)
     log_resp_shift = 0;
 }
 
+GaussianLearner::GaussianLearner(unsigned int feature_index, double pos_class_mean, double pos_class_var,
+                                 double neg_class_mean, double neg_class_var, double log_resp_shift) :
+    feature_index(feature_index),
+    pos_class_mean(pos_class_mean),
+    pos_class_var(pos_class_var),
+    neg_class_mean(neg_class_mean),
+    neg_class_var(neg_class_var),
+    log_resp_shift(log_resp_shift)
+{
+}
+
 GaussianLearner::~GaussianLearner()
 {
 
@@ -59,9 +70,10 @@ void GaussianLearner::train(const Dataset & training_dataset, const vector<doubl
     vector<double> pos_class_resp, neg_class_resp;
 
     // compute feature (real-valued number) for each data sample
+    FeatureColumn feature_column = training_dataset.column(feature_index);
     for (unsigned int i = 0; i < training_dataset.size(); i++)
     {
-        double fval = training_dataset[i][feature_index];
+        double fval = feature_column[i];
 
         if (isfinite(fval) )  // discard samples where feature is N.A.
         {
@@ -101,7 +113,7 @@ double GaussianLearner::log_probability_neg_class(double val) const
     return -0.5 * pow(val - neg_class_mean, 2) / neg_class_var - log(sqrt(2 * M_PI * neg_class_var));
 }
 
-double GaussianLearner::response(const DataInstance & data_instance) const
+double GaussianLearner::response(const DataRow & data_instance) const
 {
     double val = data_instance[feature_index];
 
@@ -114,7 +126,7 @@ double GaussianLearner::response(const DataInstance & data_instance) const
     return result;
 }
 
-int GaussianLearner::classify(const DataInstance & data_instance) const
+int GaussianLearner::classify(const DataRow & data_instance) const
 {
     double fval = response(data_instance);
 
@@ -33,11 +33,21 @@ public:
 
     GaussianLearner();
     GaussianLearner(unsigned int feature_index);
+    // already trained learner
+    GaussianLearner(unsigned int feature_index, double pos_class_mean, double pos_class_var,
+                    double neg_class_mean, double neg_class_var, double log_resp_shift);
     ~GaussianLearner();
 
     void train(const Dataset & training_dataset, const std::vector<double> &data_weights);
-    double response(const DataInstance & data_instance) const;
-    int    classify(const DataInstance & data_instance) const;
+    double response(const DataRow & data_instance) const;
+    int    classify(const DataRow & data_instance) const;
+
+    unsigned int getFeatureIndex() const { return feature_index; }
+    double getPosClassMean() const { return pos_class_mean; }
+    double getPosClassVar() const { return pos_class_var; }
+    double getNegClassMean() const { return neg_class_mean; }
+    double getNegClassVar() const { return neg_class_var; }
+    double getLogRespShift() const { return log_resp_shift; }
 
 private:
 
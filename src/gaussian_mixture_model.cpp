@@ -40,37 +40,28 @@ GaussianMixtureModel::GaussianMixtureModel(int ngauss, int max_iter)
 }
 
 
-void GaussianMixtureModel::initialize(int dim, int nsamples)
+void GaussianMixtureModel::initialize(int dimension, int num_samples)
 {
+    dim = dimension;
+    nsamples = num_samples;
 
     pi_const = 0.5 * dim * log(M_PI);
     iterations = 0;
 
-    means.reserve(ngaussians);
-    for (int i = 0; i < ngaussians; i++)
-        means[i].reserve(dim);
+    means.assign(ngaussians, vector<double>(dim));
+    diag_covs.assign(ngaussians, vector<double>(dim));
+    weights.assign(ngaussians, 0.0);
 
-    diag_covs.reserve(ngaussians);
-    for (int i = 0; i < ngaussians; i++)
-        diag_covs[i].reserve(dim);
+    resps.assign(nsamples, vector<double>(ngaussians));
+    temp.assign(nsamples, vector<double>(ngaussians));
 
-    weights.reserve(ngaussians);
-
-    resps.reserve(nsamples);
-    for (int i = 0; i < nsamples; i++)
-        resps[i].reserve(ngaussians);
-
-    temp.reserve(nsamples);
-    for (int i = 0; i < nsamples; i++)
-        temp[i].reserve(ngaussians);
-
-    log_sqrt_determinants.reserve(ngaussians);
-    mass.reserve(ngaussians);
+    log_sqrt_determinants.assign(ngaussians, 0.0);
+    mass.assign(ngaussians, 0.0);
 }
 
 void GaussianMixtureModel::initialize_clusters_with_kmeans(const Dataset & dataset)
 {
-    // data   has size (nsamples * dim);
+    // data   has size (nsamples * dim); k-means reads it in place
 
     Kmeans kmeans(dataset, ngaussians);
     kmeans.run(100, 0.1f);
@@ -94,7 +85,7 @@ void GaussianMixtureModel::initialize_clusters_with_kmeans(const Dataset & datas
         log_sqrt_determinants[g] = log_sqrt_determinant(g);
 }
 
-double GaussianMixtureModel::gaussian_exponent(const DataInstance & x, int gaussian_index) const
+double GaussianMixtureModel::gaussian_exponent(const DataRow & x, int gaussian_index) const
 {
     double exponent = 0.0;
 
@@ -107,7 +98,7 @@ double GaussianMixtureModel::gaussian_exponent(const DataInstance & x, int gauss
     return exponent;
 }
 
-double GaussianMixtureModel::exponent_form(const DataInstance & x, int g) const
+double GaussianMixtureModel::exponent_form(const DataRow & x, int g) const
 {
     return -0.5 * gaussian_exponent(x, g) + log(weights[g]) - log_sqrt_determinants[g] -  pi_const;
 }
@@ -123,12 +114,12 @@ double GaussianMixtureModel::log_sqrt_determinant(int gaussian_index) const
 }
 
 
-double GaussianMixtureModel::response(const DataInstance & sample) const
+double GaussianMixtureModel::response(const DataRow & sample) const
 {
     return sample_log_likelihood(sample);
 }
 
-double GaussianMixtureModel::sample_log_likelihood(const DataInstance & sample) const
+double GaussianMixtureModel::sample_log_likelihood(const DataRow & sample) const
 {
     vector<double> tmp_exponents(ngaussians);
 
@@ -152,7 +143,7 @@ double GaussianMixtureModel::sample_log_likelihood(const DataInstance & sample)
 }
 
 
-int  GaussianMixtureModel::classify(const DataInstance & sample) const
+int  GaussianMixtureModel::classify(const DataRow & sample) const
 {
     vector<double> tmp_exponents(ngaussians);
 
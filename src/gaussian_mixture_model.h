@@ -17,6 +17,8 @@
  *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string>
+
 #include "classifier.h"
 #include "dataset.h"
 
@@ -29,12 +31,15 @@ class GaussianMixtureModel: public Classifier
 public:
     GaussianMixtureModel(int nGaussians, int maxIterations);
     void train(const Dataset & dataset, const std::vector<double> & weights);
-    int  classify(const DataInstance & sample) const;
-    double response(const DataInstance & sample) const;
+    int  classify(const DataRow & sample) const;
+    double response(const DataRow & sample) const;
 
 
 private:
 
+    friend void SaveModel(const GaussianMixtureModel & model, const std::string & filename);
+    friend void LoadModel(const std::string & filename, GaussianMixtureModel * model);
+
     //data
     std::vector< std::vector<double> > means;
     std::vector< std::vector<double> > diag_covs;
@@ -60,13 +65,13 @@ private:
 
     int optimalNumOfGaussians(const Dataset & training, const Dataset & validation, int lim_inf, int lim_sup) const;
 
-    double gaussian_exponent(const DataInstance & x, int gaussian_index) const;
+    double gaussian_exponent(const DataRow & x, int gaussian_index) const;
 
-    double exponent_form(const DataInstance & x, int g) const;
+    double exponent_form(const DataRow & x, int g) const;
 
     double log_sqrt_determinant(int gaussian_index) const;
 
-    double sample_log_likelihood(const DataInstance & sample) const;
+    double sample_log_likelihood(const DataRow & sample) const;
 
     double datasetLogLikelihood(const Dataset &dataset) const;
 
@@ -17,26 +17,195 @@
  *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cfloat>
 #include <iostream>
+#include <numeric>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KMEANS_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 #include "kmeans.h"
 #include "math.h"
+#include "thread_pool.h"
 
 using namespace std;
 
-Kmeans::Kmeans(const Dataset &dataset, int nclusters) : cluster_labels(dataset.size()), counters(nclusters)
+// samples processed by each task of the thread pool
+static const int ASSIGNMENT_BLOCK_SIZE = 4096;
+
+// The samples are summed into the centers in this many blocks (fewer for small datasets),
+// whatever the number of threads, and the sums of the blocks are added in order.
+static const int CENTER_SUM_BLOCKS = 64;
+
+// Kernels of the squared distance between x[0, dim) and y[0, dim). They add the squares of
+// the first dimensions into 8 partial sums (dimension d into sum d % 8), which are added
+// pairwise, then the remaining squares in turn: all compute the same distance to the bit.
+typedef double (*DistanceKernel)(const double * x, const double * y, int dim);
+
+// adds the 8 partial sums, then the squares of dimensions [d, dim); not inlined in the
+// AVX-512 kernel, where the compiler could fuse the multiply-adds (rounded once, not twice)
+__attribute__((noinline))
+static double FinishSquaredDistance(const double * sums, const double * x, const double * y, int d, int dim)
+{
+    double dist = ((sums[0] + sums[4]) + (sums[2] + sums[6])) + ((sums[1] + sums[5]) + (sums[3] + sums[7]));
+    for (; d < dim; d++)
+        dist += (x[d] - y[d]) * (x[d] - y[d]);
+
+    return dist;
+}
+
+static double SquaredDistanceScalar(const double * x, const double * y, int dim)
+{
+    double sums[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+    int d = 0;
+    for (; d + 8 <= dim; d += 8)
+        for (int k = 0; k < 8; k++)
+        {
+            double diff = x[d + k] - y[d + k];
+            sums[k] += diff * diff;
+        }
+
+    return FinishSquaredDistance(sums, x, y, d, dim);
+}
+
+#ifdef KMEANS_X86_KERNELS
+
+__attribute__((target("avx2")))
+static double SquaredDistanceAvx2(const double * x, const double * y, int dim)
+{
+    __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+
+    int d = 0;
+    for (; d + 8 <= dim; d += 8)
+    {
+        __m256d diff_low = _mm256_sub_pd(_mm256_loadu_pd(x + d), _mm256_loadu_pd(y + d));
+        __m256d diff_high = _mm256_sub_pd(_mm256_loadu_pd(x + d + 4), _mm256_loadu_pd(y + d + 4));
+        low = _mm256_add_pd(low, _mm256_mul_pd(diff_low, diff_low));
+        high = _mm256_add_pd(high, _mm256_mul_pd(diff_high, diff_high));
+    }
+
+    double sums[8];
+    _mm256_storeu_pd(sums, low);
+    _mm256_storeu_pd(sums + 4, high);
+
+    // the rest is not AVX code, which would run slowly with the upper halves of the registers set
+    _mm256_zeroupper();
+    return FinishSquaredDistance(sums, x, y, d, dim);
+}
+
+__attribute__((target("avx512f")))
+static double SquaredDistanceAvx512(const double * x, const double * y, int dim)
+{
+    __m512d sums = _mm512_setzero_pd();
+
+    int d = 0;
+    for (; d + 8 <= dim; d += 8)
+    {
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(x + d), _mm512_loadu_pd(y + d));
+        // explicit rounding, so that they are not fused into a multiply-add (rounded once)
+        __m512d squares = _mm512_maskz_mul_round_pd(0xFF, diff, diff, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        sums = _mm512_maskz_add_round_pd(0xFF, sums, squares, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+
+    double lanes[8];
+    _mm512_storeu_pd(lanes, sums);
+
+    _mm256_zeroupper();
+    return FinishSquaredDistance(lanes, x, y, d, dim);
+}
+
+#endif  // KMEANS_X86_KERNELS
+
+static DistanceKernel SelectDistanceKernel(SimdLevel level)
+{
+#ifdef KMEANS_X86_KERNELS
+    if (level == SIMD_AVX512)
+        return SquaredDistanceAvx512;
+    if (level == SIMD_AVX2)
+        return SquaredDistanceAvx2;
+#endif
+    return SquaredDistanceScalar;
+}
+
+// the features of 'x' in one array: its own if they are contiguous, else copied to 'buffer'
+static const double * ContiguousValues(const DataRow & x, vector<double> & buffer)
+{
+    if (x.isContiguous())
+        return x.data();
+
+    buffer.resize(x.size());
+    for (size_t d = 0; d < x.size(); d++)
+        buffer[d] = x[d];
+    return buffer.data();
+}
+
+// squared distances of 'x' to all the centers
+static void SquaredDistances(const double * x, const vector< vector<double> > & centers, DistanceKernel kernel,
+                             double * distances)
+{
+    for (size_t c = 0; c < centers.size(); c++)
+        distances[c] = kernel(x, centers[c].data(), centers[c].size());
+}
+
+// runs task(first, last) on the samples [0, nsamples) in blocks, in parallel
+template<class Task>
+static void ForEachBlock(ThreadPool & pool, int nsamples, const Task & task)
+{
+    size_t nblocks = (nsamples + ASSIGNMENT_BLOCK_SIZE - 1) / ASSIGNMENT_BLOCK_SIZE;
+
+    pool.run(nblocks, [&](size_t block, int) {
+        int first = block * ASSIGNMENT_BLOCK_SIZE;
+        task(first, min(nsamples, first + ASSIGNMENT_BLOCK_SIZE));
+    });
+}
+
+Kmeans::Kmeans(const Dataset &dataset, int nclusters) :
+    cluster_labels(dataset.size()), counters(nclusters), dataset(dataset)
 {
     assert(nclusters > 0);
     assert(dataset.size() > nclusters);
 
-    this->dataset = dataset;
     this->nsamples = dataset.size();
     this->dim = dataset[0].size();
     this->nclusters = nclusters;
     this->iterations = 0;
     this->prev_error = DBL_MAX;
+    this->seeding = RANDOM_PARTITION;
+    this->seed = 0;
+    this->algorithm = LLOYD;
+    this->bounds_valid = false;
+    this->num_threads = 1;
+    this->simd_level = DetectSimdLevel();
+
+    for (int i = 0; i < nclusters; ++i)
+        cluster_centers.push_back( vector<double>(dim));
+}
+
+Kmeans::Kmeans(const Dataset &dataset, const vector<unsigned int> & sample_indices, int nclusters) :
+    cluster_labels(sample_indices.size()), counters(nclusters), dataset(dataset), sample_indices(sample_indices)
+{
+    assert(nclusters > 0);
+    assert((int) sample_indices.size() > nclusters);
+
+    for (size_t s = 0; s < sample_indices.size(); s++)
+        assert(sample_indices[s] < dataset.size());
+
+    this->nsamples = sample_indices.size();
+    this->dim = dataset.dimension();
+    this->nclusters = nclusters;
+    this->iterations = 0;
+    this->prev_error = DBL_MAX;
+    this->seeding = RANDOM_PARTITION;
+    this->seed = 0;
+    this->algorithm = LLOYD;
+    this->bounds_valid = false;
+    this->num_threads = 1;
+    this->simd_level = DetectSimdLevel();
 
     for (int i = 0; i < nclusters; ++i)
         cluster_centers.push_back( vector<double>(dim));
@@ -46,7 +215,49 @@ Kmeans::~Kmeans()
 {
 }
 
-void Kmeans::initialize() {
+void Kmeans::setSeeding(Seeding seeding, unsigned int seed)
+{
+    this->seeding = seeding;
+    this->seed = seed;
+}
+
+void Kmeans::setAlgorithm(Algorithm algorithm)
+{
+    this->algorithm = algorithm;
+    this->bounds_valid = false;
+}
+
+void Kmeans::setNumThreads(int nthreads)
+{
+    num_threads = nthreads;
+}
+
+void Kmeans::setSimdLevel(SimdLevel level)
+{
+    simd_level = min(level, DetectSimdLevel());
+}
+
+void Kmeans::initialize(ThreadPool & pool) {
+
+    bounds_valid = false;
+
+    if (seeding != RANDOM_PARTITION)
+    {
+        mt19937 rng(seed);
+
+        if (seeding == KMEANS_PARALLEL)
+            seedParallel(rng, pool);
+        else
+        {
+            vector<int> all_samples(nsamples);
+            iota(all_samples.begin(), all_samples.end(), 0);
+            seedPlusPlus(all_samples, vector<double>(nsamples, 1.0), rng, pool);
+        }
+
+        // the first iteration of run() recomputes the centers from these labels
+        updateAssignments(pool);
+        return;
+    }
 
     /* initialize random seed: */
     //  srand ( time(NULL) );
@@ -66,54 +277,464 @@ void Kmeans::initialize() {
         cluster_labels[s] = cluster_labels[new_pos];
         cluster_labels[new_pos] = tmp;
     }
-    computeCenters();
+    computeCenters(pool);
 }
 
+// Draws an index with probability proportional to probabilities[index]. They are summed per
+// block of ASSIGNMENT_BLOCK_SIZE in 'block_totals', which add up to 'total', so that the draw
+// skips whole blocks.
+static int Draw(const vector<double> & probabilities, const vector<double> & block_totals, double total,
+                mt19937 & rng)
+{
+    double u = uniform_real_distribution<double>(0.0, total)(rng);
 
-void Kmeans::computeCenters() {
+    size_t block = 0;
+    while (block + 1 < block_totals.size() && u >= block_totals[block])
+    {
+        u -= block_totals[block];
+        block++;
+    }
+
+    size_t first = block * ASSIGNMENT_BLOCK_SIZE;
+    size_t last = min(probabilities.size(), first + ASSIGNMENT_BLOCK_SIZE);
+    for (size_t i = first; i < last; i++)
+    {
+        u -= probabilities[i];
+        if (u < 0.0)
+            return i;
+    }
+
+    // rounding errors: the last index of nonzero probability
+    int index = last - 1;
+    while (index > 0 && probabilities[index] == 0.0)
+        index--;
+    return index;
+}
+
+void Kmeans::seedPlusPlus(const vector<int> & candidates, const vector<double> & weights, mt19937 & rng,
+                          ThreadPool & pool)
+{
+    int ncandidates = candidates.size();
+    assert(ncandidates >= nclusters);
 
-    for (int i = 0; i < nclusters; i++)
-        counters[i] = 0;
+    DistanceKernel kernel = SelectDistanceKernel(simd_level);
 
-    for (int s = 0; s < nsamples ; s++)
+    // weight times squared distance to the closest center drawn, for each candidate
+    vector<double> probabilities(weights), distances(ncandidates, DBL_MAX);
+    vector<double> block_totals((ncandidates + ASSIGNMENT_BLOCK_SIZE - 1) / ASSIGNMENT_BLOCK_SIZE);
+
+    // total of 'probabilities' set to the weights
+    auto weightTotal = [&]() {
+        for (size_t block = 0; block < block_totals.size(); block++)
+        {
+            size_t first = block * ASSIGNMENT_BLOCK_SIZE, last = min<size_t>(ncandidates, first + ASSIGNMENT_BLOCK_SIZE);
+            block_totals[block] = accumulate(weights.begin() + first, weights.begin() + last, 0.0);
+        }
+        return accumulate(block_totals.begin(), block_totals.end(), 0.0);
+    };
+    double total = weightTotal();
+
+    for (int c = 0; c < nclusters; c++)
     {
-        int cl = cluster_labels[s];
-        counters[cl]++;
+        // all candidates at a center already (duplicates): any of them, by weight
+        if (!(total > 0.0))
+        {
+            probabilities = weights;
+            total = weightTotal();
+        }
 
+        DataRow center = sample(candidates[Draw(probabilities, block_totals, total, rng)]);
         for (int d = 0; d < dim; d++)
-            cluster_centers[cl][d] = cluster_centers[cl][d] * ((counters[cl] - 1.0) / counters[cl]) + 1.0 * dataset[s][d] / counters[cl];
+            cluster_centers[c][d] = center[d];
+
+        ForEachBlock(pool, ncandidates, [&](int first, int last) {
+            vector<double> buffer;
+            double block_total = 0.0;
+            for (int i = first; i < last; i++)
+            {
+                const double * x = ContiguousValues(sample(candidates[i]), buffer);
+                distances[i] = min(distances[i], kernel(x, cluster_centers[c].data(), dim));
+                probabilities[i] = weights[i] * distances[i];
+                block_total += probabilities[i];
+            }
+            block_totals[first / ASSIGNMENT_BLOCK_SIZE] = block_total;
+        });
+        total = accumulate(block_totals.begin(), block_totals.end(), 0.0);
     }
 }
 
-void Kmeans::updateAssignments() {
+void Kmeans::seedParallel(mt19937 & rng, ThreadPool & pool)
+{
+    // oversampling factor and passes of Bahmani et al. (2012), which are enough in practice
+    const double oversampling = 2.0 * nclusters;
+    const int rounds = 5;
+
+    DistanceKernel kernel = SelectDistanceKernel(simd_level);
+    size_t nblocks = (nsamples + ASSIGNMENT_BLOCK_SIZE - 1) / ASSIGNMENT_BLOCK_SIZE;
+
+    vector<int> candidates(1, uniform_int_distribution<int>(0, nsamples - 1)(rng));
+    vector<double> distances(nsamples, DBL_MAX);
+    vector<int> closest(nsamples);
+    vector<double> block_costs(nblocks);
+    vector< vector<int> > block_draws(nblocks);
+    vector<double> new_candidates;      // values of the candidates drawn in the last round
+    size_t first_new = 0;
+
+    for (int round = 0; round <= rounds; round++)
+    {
+        new_candidates.resize((candidates.size() - first_new) * dim);
+        for (size_t c = first_new; c < candidates.size(); c++)
+        {
+            DataRow candidate = sample(candidates[c]);
+            for (int d = 0; d < dim; d++)
+                new_candidates[(c - first_new) * dim + d] = candidate[d];
+        }
 
-    for (int s = 0; s < nsamples ; s++) {
-        cluster_labels[s] = getClosestClusterLabel(dataset[s]);
+        // closest candidate to each sample and squared distance to it, updated with the new ones
+        ForEachBlock(pool, nsamples, [&](int first, int last) {
+            vector<double> buffer;
+            double cost = 0.0;
+            for (int s = first; s < last; s++)
+            {
+                const double * x = ContiguousValues(sample(s), buffer);
+                for (size_t c = first_new; c < candidates.size(); c++)
+                {
+                    double distance = kernel(x, &new_candidates[(c - first_new) * dim], dim);
+                    if (distance < distances[s])
+                    {
+                        distances[s] = distance;
+                        closest[s] = c;
+                    }
+                }
+                cost += distances[s];
+            }
+            block_costs[first / ASSIGNMENT_BLOCK_SIZE] = cost;
+        });
+        double cost = accumulate(block_costs.begin(), block_costs.end(), 0.0);
+
+        first_new = candidates.size();
+        if (round == rounds || !(cost > 0.0))
+            break;
+
+        // each sample drawn independently, with a generator per block seeded from 'rng', so
+        // that the draws do not depend on the number of threads
+        unsigned int round_seed = rng();
+        ForEachBlock(pool, nsamples, [&](int first, int last) {
+            seed_seq block_seed = {round_seed, (unsigned int) (first / ASSIGNMENT_BLOCK_SIZE)};
+            mt19937 block_rng(block_seed);
+            uniform_real_distribution<double> uniform(0.0, 1.0);
+
+            vector<int> & draws = block_draws[first / ASSIGNMENT_BLOCK_SIZE];
+            draws.clear();
+            for (int s = first; s < last; s++)
+                if (uniform(block_rng) * cost < oversampling * distances[s])
+                    draws.push_back(s);
+        });
+
+        for (size_t block = 0; block < nblocks; block++)
+            candidates.insert(candidates.end(), block_draws[block].begin(), block_draws[block].end());
     }
 
+    // too few distinct samples drawn
+    if ((int) candidates.size() < nclusters)
+    {
+        vector<int> all_samples(nsamples);
+        iota(all_samples.begin(), all_samples.end(), 0);
+        seedPlusPlus(all_samples, vector<double>(nsamples, 1.0), rng, pool);
+        return;
+    }
+
+    // each candidate weighs the number of samples closest to it
+    vector<double> weights(candidates.size(), 0.0);
+    for (int s = 0; s < nsamples; s++)
+        weights[closest[s]] += 1.0;
+
+    seedPlusPlus(candidates, weights, rng, pool);
 }
 
+void Kmeans::computeCenters(ThreadPool & pool) {
 
-int Kmeans::getClosestClusterLabel(const DataInstance & x) const
-{
-    int ind = -1;
-    double min = DBL_MAX, cur_dist;
+    // sums and counts of the samples of each cluster, per block of samples
+    int nblocks = min(CENTER_SUM_BLOCKS, nsamples);
+    vector<double> sums((size_t) nblocks * nclusters * dim, 0.0);
+    vector<int> block_counters((size_t) nblocks * nclusters, 0);
+
+    pool.run(nblocks, [&](size_t block, int) {
+        int first = block * nsamples / nblocks, last = (block + 1) * nsamples / nblocks;
+        double * block_sums = &sums[block * nclusters * dim];
+        int * block_counter = &block_counters[block * nclusters];
+
+        vector<double> buffer;
+        for (int s = first; s < last; s++)
+        {
+            int cl = cluster_labels[s];
+            block_counter[cl]++;
+
+            const double * x = ContiguousValues(sample(s), buffer);
+            double * sum = block_sums + (size_t) cl * dim;
+            for (int d = 0; d < dim; d++)
+                sum[d] += x[d];
+        }
+    });
+
+    for (int cl = 0; cl < nclusters; cl++)
+    {
+        counters[cl] = 0;
+        for (int block = 0; block < nblocks; block++)
+            counters[cl] += block_counters[(size_t) block * nclusters + cl];
+
+        // an empty cluster keeps its center
+        if (counters[cl] == 0)
+            continue;
+
+        for (int d = 0; d < dim; d++)
+        {
+            double sum = 0.0;
+            for (int block = 0; block < nblocks; block++)
+                sum += sums[((size_t) block * nclusters + cl) * dim + d];
+
+            cluster_centers[cl][d] = sum / counters[cl];
+        }
+    }
+}
+
+void Kmeans::updateAssignments(ThreadPool & pool) {
+
+    if (algorithm == LLOYD)
+    {
+        DistanceKernel kernel = SelectDistanceKernel(simd_level);
+
+        ForEachBlock(pool, nsamples, [&](int first, int last) {
+            vector<double> buffer, distances(nclusters);
+            for (int s = first; s < last; s++)
+            {
+                SquaredDistances(ContiguousValues(sample(s), buffer), cluster_centers, kernel, distances.data());
+                cluster_labels[s] = min_element(distances.begin(), distances.end()) - distances.begin();
+            }
+        });
+        return;
+    }
 
-    for (int i = 0; i < nclusters; i++)
+    if (!bounds_valid)
     {
-        cur_dist = l2norm(x, cluster_centers[i]);
+        assignAndSetBounds(pool);
+        return;
+    }
+
+    // how far each center moved since the last assignment
+    vector<double> drifts(nclusters);
+    for (int c = 0; c < nclusters; c++)
+        drifts[c] = l2norm(previous_centers[c], cluster_centers[c]);
+
+    if (algorithm == HAMERLY)
+        updateAssignmentsHamerly(drifts, pool);
+    else
+        updateAssignmentsElkan(drifts, pool);
+
+    previous_centers = cluster_centers;
+}
 
-        if (cur_dist < min) {
-            min = cur_dist;
-            ind = i;
+// Relative margin by which the bounds must differ for a distance to be skipped. The bounds
+// come from computed distances, so they are off by rounding errors, far below this margin:
+// a distance is only skipped if Lloyd would also find it larger, not equal.
+static const double BOUND_TOLERANCE = 1e-10;
+
+// true if a distance of at most 'upper' is smaller than one of at least 'lower'
+static bool Below(double upper, double lower)
+{
+    return upper < lower * (1.0 - BOUND_TOLERANCE);
+}
+
+// distances between the centers, and half the distance of each one to the closest other one
+static void ComputeCenterDistances(const vector< vector<double> > & centers, vector<double> & distances,
+                                   vector<double> & half_separations)
+{
+    size_t ncenters = centers.size(), dim = centers[0].size();
+    distances.assign(ncenters * ncenters, 0.0);
+    half_separations.assign(ncenters, DBL_MAX);
+
+    for (size_t c = 0; c < ncenters; c++)
+        for (size_t other = c + 1; other < ncenters; other++)
+        {
+            double distance = 0.0;
+            for (size_t d = 0; d < dim; d++)
+                distance += (centers[c][d] - centers[other][d]) * (centers[c][d] - centers[other][d]);
+            distance = sqrt(distance);
+
+            distances[c * ncenters + other] = distances[other * ncenters + c] = distance;
+            half_separations[c] = min(half_separations[c], 0.5 * distance);
+            half_separations[other] = min(half_separations[other], 0.5 * distance);
         }
+}
+
+// index of the smallest of distances[0, n), the first one if tied, and the second smallest
+static int Closest(const double * distances, int n, double * out_min, double * out_second)
+{
+    int closest = -1;
+    double min = DBL_MAX, second = DBL_MAX;
+    for (int c = 0; c < n; c++)
+    {
+        if (distances[c] < min)
+        {
+            second = min;
+            min = distances[c];
+            closest = c;
+        }
+        else
+            second = std::min(second, distances[c]);
     }
 
-    assert(ind >= 0);
-    return ind;
+    assert(closest >= 0);
+    *out_min = min;
+    *out_second = second;
+    return closest;
+}
+
+void Kmeans::assignAndSetBounds(ThreadPool & pool)
+{
+    upper_bounds.resize(nsamples);
+    lower_bounds.resize(algorithm == ELKAN ? (size_t) nsamples * nclusters : nsamples);
+    DistanceKernel kernel = SelectDistanceKernel(simd_level);
+
+    ForEachBlock(pool, nsamples, [&](int first, int last) {
+        vector<double> buffer, distances(nclusters);
+        for (int s = first; s < last; s++)
+        {
+            // same comparisons as Lloyd, on squared distances
+            SquaredDistances(ContiguousValues(sample(s), buffer), cluster_centers, kernel, distances.data());
+
+            double min, second;
+            cluster_labels[s] = Closest(distances.data(), nclusters, &min, &second);
+            upper_bounds[s] = sqrt(min);
+
+            if (algorithm == ELKAN)
+                for (int c = 0; c < nclusters; c++)
+                    lower_bounds[(size_t) s * nclusters + c] = sqrt(distances[c]);
+            else
+                lower_bounds[s] = sqrt(second);
+        }
+    });
+
+    previous_centers = cluster_centers;
+    bounds_valid = true;
+}
+
+void Kmeans::updateAssignmentsHamerly(const vector<double> & drifts, ThreadPool & pool)
+{
+    vector<double> center_distances, half_separations;
+    ComputeCenterDistances(cluster_centers, center_distances, half_separations);
+
+    // the lower bound of a sample moves by the largest drift of the other centers
+    int fastest = max_element(drifts.begin(), drifts.end()) - drifts.begin();
+    double max_drift = drifts[fastest], second_drift = 0.0;
+    for (int c = 0; c < nclusters; c++)
+        if (c != fastest)
+            second_drift = max(second_drift, drifts[c]);
+
+    DistanceKernel kernel = SelectDistanceKernel(simd_level);
+
+    ForEachBlock(pool, nsamples, [&](int first, int last) {
+        vector<double> buffer, distances(nclusters);
+        for (int s = first; s < last; s++)
+        {
+            int closest = cluster_labels[s];
+            upper_bounds[s] += drifts[closest];
+            lower_bounds[s] -= (closest == fastest) ? second_drift : max_drift;
+
+            double bound = max(half_separations[closest], lower_bounds[s]);
+            if (Below(upper_bounds[s], bound))
+                continue;
+
+            const double * x = ContiguousValues(sample(s), buffer);
+            upper_bounds[s] = sqrt(kernel(x, cluster_centers[closest].data(), dim));
+            if (Below(upper_bounds[s], bound))
+                continue;
+
+            // all the distances, as Lloyd
+            SquaredDistances(x, cluster_centers, kernel, distances.data());
+
+            double min, second;
+            cluster_labels[s] = Closest(distances.data(), nclusters, &min, &second);
+            upper_bounds[s] = sqrt(min);
+            lower_bounds[s] = sqrt(second);
+        }
+    });
+}
+
+void Kmeans::updateAssignmentsElkan(const vector<double> & drifts, ThreadPool & pool)
+{
+    vector<double> center_distances, half_separations;
+    ComputeCenterDistances(cluster_centers, center_distances, half_separations);
+    DistanceKernel kernel = SelectDistanceKernel(simd_level);
+
+    ForEachBlock(pool, nsamples, [&](int first, int last) {
+        vector<double> buffer;
+        for (int s = first; s < last; s++)
+        {
+            double * lower = &lower_bounds[(size_t) s * nclusters];
+            for (int c = 0; c < nclusters; c++)
+                lower[c] -= drifts[c];
+
+            int closest = cluster_labels[s];
+            double upper = upper_bounds[s] + drifts[closest];
+
+            if (Below(upper, half_separations[closest]))
+            {
+                upper_bounds[s] = upper;
+                continue;
+            }
+
+            // squared distance to 'closest', once computed
+            const double * x = nullptr;
+            double closest_distance = -1.0;
+
+            for (int c = 0; c < nclusters; c++)
+            {
+                if (c == closest)
+                    continue;
+
+                double bound = max(lower[c], 0.5 * center_distances[closest * nclusters + c]);
+                if (Below(upper, bound))
+                    continue;
+
+                if (x == nullptr)
+                {
+                    x = ContiguousValues(sample(s), buffer);
+                    closest_distance = kernel(x, cluster_centers[closest].data(), dim);
+                    upper = lower[closest] = sqrt(closest_distance);
+
+                    if (Below(upper, bound))
+                        continue;
+                }
+
+                // compared squared, as in Lloyd; ties go to the first center
+                double distance = kernel(x, cluster_centers[c].data(), dim);
+                lower[c] = sqrt(distance);
+                if (distance < closest_distance || (distance == closest_distance && c < closest))
+                {
+                    closest = c;
+                    closest_distance = distance;
+                    upper = lower[c];
+                }
+            }
+
+            cluster_labels[s] = closest;
+            upper_bounds[s] = upper;
+        }
+    });
 }
 
-double Kmeans::l2norm(const DataInstance & x, const vector<double> & y) const
+
+int Kmeans::getClosestClusterLabel(const DataRow & x) const
+{
+    vector<double> buffer, distances(nclusters);
+    SquaredDistances(ContiguousValues(x, buffer), cluster_centers, SelectDistanceKernel(simd_level), distances.data());
+
+    // no square root: the closest center is the same
+    return min_element(distances.begin(), distances.end()) - distances.begin();
+}
+
+double Kmeans::l2norm(const DataRow & x, const vector<double> & y) const
 {
     double dist = 0.0;
     /*
@@ -125,26 +746,31 @@ double Kmeans::l2norm(const DataInstance & x, const vector<double> & y) const
     return sqrt(dist);
 }
 
-double Kmeans::computeError() {
+double Kmeans::computeError(ThreadPool & pool) {
 
-    double error = 0.0;
+    // summed per block, then in order
+    vector<double> block_errors((nsamples + ASSIGNMENT_BLOCK_SIZE - 1) / ASSIGNMENT_BLOCK_SIZE, 0.0);
+    DistanceKernel kernel = SelectDistanceKernel(simd_level);
 
-    for (int s = 0; s < nsamples; s++)
-    {
-        double dist = l2norm(dataset[s], cluster_centers[cluster_labels[s]]);
-        error += dist;
-    }
+    ForEachBlock(pool, nsamples, [&](int first, int last) {
+        vector<double> buffer;
+        double & error = block_errors[first / ASSIGNMENT_BLOCK_SIZE];
+        for (int s = first; s < last; s++)
+            error += sqrt(kernel(ContiguousValues(sample(s), buffer), cluster_centers[cluster_labels[s]].data(), dim));
+    });
 
-    return error;
+    return accumulate(block_errors.begin(), block_errors.end(), 0.0);
 }
 
 
 void Kmeans::oneStep()
 {
+    ThreadPool pool(num_threads);
+
     prev_error = (iterations == 0) ? DBL_MAX : error;
-    computeCenters();
-    updateAssignments();
-    error = computeError();
+    computeCenters(pool);
+    updateAssignments(pool);
+    error = computeError(pool);
 
     iterations++;
 }
@@ -153,19 +779,21 @@ void Kmeans::oneStep()
 
 int Kmeans::run(int max_iterations, float min_delta_improv) {
 
-    initialize();
+    ThreadPool pool(num_threads);
+
+    initialize(pool);
 
     prev_error = DBL_MAX;
-    error = computeError();
+    error = computeError(pool);
 
     iterations = 0;
 
     for ( ; (iterations < max_iterations) && (prev_error - error > min_delta_improv); iterations++)
     {
-        computeCenters();
-        updateAssignments();
+        computeCenters(pool);
+        updateAssignments(pool);
         prev_error = error;
-        error = computeError();
+        error = computeError(pool);
     }
 
     return iterations;
@@ -17,41 +17,114 @@
  *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <random>
+#include <vector>
+
+#include "cpu_features.h"
 #include "dataset.h"
 
+class ThreadPool;
+
 #ifndef KMEANS_H_
 #define KMEANS_H_
 
+/// K-means clustering of the samples of a dataset, which is borrowed, not copied:
+/// it must outlive the Kmeans object and not be modified while it is used.
 class  Kmeans {
 
     friend class GaussianMixtureModel;
+    friend class MiniBatchKmeans;
 
 public:
 
     Kmeans(const Dataset & dataset, int nclusters);
+    // clusters only the samples of 'dataset' at 'sample_indices' (e.g. a random sample of its rows)
+    Kmeans(const Dataset & dataset, const std::vector<unsigned int> & sample_indices, int nclusters);
     ~Kmeans();
 
+    /// How run() chooses the initial centers:
+    ///  - RANDOM_PARTITION (the default) averages the samples of a random partition drawn with
+    ///    rand(), which puts all the centers near the mean of the samples
+    ///  - KMEANS_PLUS_PLUS (k-means++) draws samples one after the other, each with a probability
+    ///    proportional to its squared distance to the closest center already drawn
+    ///  - KMEANS_PARALLEL (k-means||) draws about 2 * nclusters samples at once in each of a few
+    ///    passes, the same way, then reduces them to nclusters centers with k-means++. It needs
+    ///    fewer passes over the samples than k-means++ (nclusters), for large datasets.
+    enum Seeding { RANDOM_PARTITION, KMEANS_PLUS_PLUS, KMEANS_PARALLEL };
+    // the last two draw from a generator seeded with 'seed', so the clustering depends on it only
+    void setSeeding(Seeding seeding, unsigned int seed);
+
+    /// How each iteration assigns the samples to their closest center:
+    ///  - LLOYD (the default) computes the distances of every sample to every center
+    ///  - HAMERLY keeps for each sample an upper bound on the distance to its center and a lower
+    ///    bound on the distance to the others, moved by how far the centers moved, and skips
+    ///    the samples whose bounds show that the center is unchanged (memory: 2 per sample)
+    ///  - ELKAN keeps a lower bound per sample and center, and also skips single centers, using
+    ///    the distances between centers. It skips more distances with many clusters, at the
+    ///    cost of nsamples * nclusters doubles.
+    /// The assignments, hence the clustering, are exactly those of LLOYD.
+    enum Algorithm { LLOYD, HAMERLY, ELKAN };
+    void setAlgorithm(Algorithm algorithm);
+
+    // Number of threads assigning the samples and summing them into the centers (1, the default;
+    // <= 0 uses one thread per core). The result does not depend on it.
+    void setNumThreads(int nthreads);
+
+    // Highest instruction set used for the distances (default and maximum: DetectSimdLevel()).
+    // The result does not depend on it.
+    void setSimdLevel(SimdLevel level);
+
     int run(int max_iterations, float min_delta_improv);
-    int getClosestClusterLabel(const DataInstance & x) const;
+    int getClosestClusterLabel(const DataRow & x) const;
 
 private:
 
-    void initialize();
-    void computeCenters();
-    void updateAssignments();
-    double computeError();
+    void initialize(ThreadPool & pool);
+
+    // k-means++ among the samples at positions 'candidates', which count 'weights[c]' times each
+    void seedPlusPlus(const std::vector<int> & candidates, const std::vector<double> & weights, std::mt19937 & rng,
+                      ThreadPool & pool);
+    void seedParallel(std::mt19937 & rng, ThreadPool & pool);
+    void computeCenters(ThreadPool & pool);
+    void updateAssignments(ThreadPool & pool);
+
+    // computes all the distances, like Lloyd, and sets the bounds from them
+    void assignAndSetBounds(ThreadPool & pool);
+    void updateAssignmentsHamerly(const std::vector<double> & drifts, ThreadPool & pool);
+    void updateAssignmentsElkan(const std::vector<double> & drifts, ThreadPool & pool);
+    double computeError(ThreadPool & pool);
     void oneStep();
 
-    double l2norm(const DataInstance & x, const std::vector<double> & y) const;
+    double l2norm(const DataRow & x, const std::vector<double> & y) const;
+
+    // s-th sample clustered, in [0, nsamples)
+    DataRow sample(int s) const
+    {
+        return sample_indices.empty() ? dataset[s] : dataset[sample_indices[s]];
+    }
 
     std::vector<int> cluster_labels, counters;
-    Dataset dataset;
+    const Dataset & dataset;
+    std::vector<unsigned int> sample_indices;     // empty when all the samples are clustered
     std::vector< std::vector<double> > cluster_centers;
     int nclusters;
     int nsamples, dim;
     int iterations;
     double prev_error, error;
 
+    Seeding seeding;
+    unsigned int seed;
+
+    int num_threads;
+    SimdLevel simd_level;
+
+    // bounds of HAMERLY and ELKAN, valid for the centers of the last assignment (previous_centers)
+    Algorithm algorithm;
+    bool bounds_valid;
+    std::vector< std::vector<double> > previous_centers;
+    std::vector<double> upper_bounds;
+    std::vector<double> lower_bounds;   // HAMERLY: per sample; ELKAN: per sample and center
+
 };
 
 #endif
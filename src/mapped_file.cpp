@@ -0,0 +1,75 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+using namespace std;
+
+MappedFile::MappedFile(const string & filename) :
+    mapped_data(nullptr), mapped_size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Cannot open file: " + filename);
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw runtime_error("Cannot stat file: " + filename);
+    }
+
+    mapped_size = file_stat.st_size;
+
+    if (mapped_size > 0)
+    {
+        void * addr = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            throw runtime_error("Cannot map file: " + filename);
+        }
+        mapped_data = static_cast<const char *>(addr);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped_data != nullptr)
+        munmap(const_cast<char *>(mapped_data), mapped_size);
+}
+
+const char * MappedFile::data() const
+{
+    return mapped_data;
+}
+
+size_t MappedFile::size() const
+{
+    return mapped_size;
+}
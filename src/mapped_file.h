@@ -0,0 +1,49 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+/// Read-only memory mapping of a whole file. The mapping is shared, so several
+/// processes mapping the same file use the same pages of the page cache.
+class MappedFile
+{
+public:
+
+    // throws std::runtime_error if the file can not be opened or mapped
+    explicit MappedFile(const std::string & filename);
+    ~MappedFile();
+
+    const char * data() const;
+    size_t size() const;
+
+private:
+
+    // not copyable: the mapping is released by the destructor
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+
+    const char * mapped_data;
+    size_t mapped_size;
+};
+
+#endif  // MAPPED_FILE_H_
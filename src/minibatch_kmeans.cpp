@@ -0,0 +1,125 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cfloat>
+
+#include "kmeans.h"
+#include "minibatch_kmeans.h"
+
+using namespace std;
+
+MiniBatchKmeans::MiniBatchKmeans(int nclusters, unsigned int seed) :
+    nclusters(nclusters), rng(seed)
+{
+    assert(nclusters > 0);
+}
+
+void MiniBatchKmeans::initialize(const Dataset & batch)
+{
+    assert((int) batch.size() > nclusters);
+
+    // k-means++ centers, without Lloyd iterations
+    Kmeans seeding(batch, nclusters);
+    seeding.setSeeding(Kmeans::KMEANS_PLUS_PLUS, rng());
+    seeding.run(0, 0.0f);
+
+    cluster_centers = seeding.cluster_centers;
+    counts.assign(nclusters, 0);
+}
+
+void MiniBatchKmeans::update(const Dataset & batch)
+{
+    if (cluster_centers.empty())
+        initialize(batch);
+
+    assert(batch.dimension() == cluster_centers[0].size());
+    size_t dim = batch.dimension();
+
+    // samples are assigned to the centers as they were before the batch
+    batch_labels.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++)
+        batch_labels[i] = getClosestClusterLabel(batch[i]);
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        int cl = batch_labels[i];
+        counts[cl]++;
+
+        // per-center learning rate
+        double rate = 1.0 / counts[cl];
+        DataRow x = batch[i];
+        for (size_t d = 0; d < dim; d++)
+            cluster_centers[cl][d] += rate * (x[d] - cluster_centers[cl][d]);
+    }
+}
+
+void MiniBatchKmeans::run(const Dataset & dataset, size_t batch_size, int nbatches)
+{
+    assert(dataset.size() > 0 && batch_size > 0);
+
+    uniform_int_distribution<size_t> draw(0, dataset.size() - 1);
+    sampled_batch.reserve(batch_size);
+
+    for (int b = 0; b < nbatches; b++)
+    {
+        sampled_batch.clear();
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            size_t s = draw(rng);
+            sampled_batch.add(dataset[s], dataset.getLabelAt(s));
+        }
+
+        update(sampled_batch);
+    }
+}
+
+int MiniBatchKmeans::getClosestClusterLabel(const DataRow & x) const
+{
+    assert(!cluster_centers.empty());
+
+    int ind = -1;
+    double min = DBL_MAX;
+
+    for (int c = 0; c < nclusters; c++)
+    {
+        double dist = 0.0;
+        for (size_t d = 0; d < x.size(); d++)
+            dist += (x[d] - cluster_centers[c][d]) * (x[d] - cluster_centers[c][d]);
+
+        if (dist < min)
+        {
+            min = dist;
+            ind = c;
+        }
+    }
+
+    assert(ind >= 0);
+    return ind;
+}
+
+const vector< vector<double> > & MiniBatchKmeans::getClusterCenters() const
+{
+    return cluster_centers;
+}
+
+const vector<size_t> & MiniBatchKmeans::getClusterCounts() const
+{
+    return counts;
+}
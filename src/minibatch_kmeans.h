@@ -0,0 +1,75 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINIBATCH_KMEANS_H_
+#define MINIBATCH_KMEANS_H_
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "dataset.h"
+
+/// Mini-batch k-means (Sculley, 2010): the centers are updated from small batches of samples,
+/// one at a time, instead of passes over all of them. Each sample of a batch moves its closest
+/// center towards it by 1 / (number of samples assigned to that center so far), so a center is
+/// the running mean of the samples it was assigned. The batches can be drawn from a dataset
+/// (run) or come from a stream, e.g. a CsvBatchReader (update), for data larger than memory:
+///
+///   MiniBatchKmeans kmeans(100, seed);
+///   CsvBatchReader reader("data.csv", 10000);
+///   Dataset batch;
+///   while (reader.next(&batch))
+///       kmeans.update(batch);
+class MiniBatchKmeans
+{
+public:
+
+    // 'seed' seeds the generator of the initial centers and of the batches drawn by run()
+    MiniBatchKmeans(int nclusters, unsigned int seed);
+
+    // Moves the centers towards the samples of 'batch', which is not kept. The first batch
+    // must have more than nclusters samples: the initial centers are drawn from it with k-means++.
+    void update(const Dataset & batch);
+
+    // Updates the centers with 'nbatches' batches of 'batch_size' samples of 'dataset', drawn
+    // at random (with replacement). Only those samples are read.
+    void run(const Dataset & dataset, size_t batch_size, int nbatches);
+
+    int getClosestClusterLabel(const DataRow & x) const;
+
+    const std::vector< std::vector<double> > & getClusterCenters() const;
+
+    // number of samples each center was updated with, so far
+    const std::vector<size_t> & getClusterCounts() const;
+
+private:
+
+    void initialize(const Dataset & batch);
+
+    int nclusters;
+    std::mt19937 rng;
+
+    std::vector< std::vector<double> > cluster_centers;
+    std::vector<size_t> counts;
+    std::vector<int> batch_labels;
+    Dataset sampled_batch;      // storage of the batches drawn by run()
+};
+
+#endif  // MINIBATCH_KMEANS_H_
@@ -0,0 +1,419 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+#include "gaussian_learner.h"
+#include "mapped_file.h"
+#include "model_file.h"
+#include "threshold_learner.h"
+
+using namespace std;
+
+namespace
+{
+
+const char MODEL_FILE_MAGIC[8] = {'L', 'A', 'K', 'E', 'M', 'L', 'M', 'D'};
+const uint64_t SECTION_ALIGNMENT = 64;
+const int MAX_SECTIONS = 8;
+const int NAIVE_BAYES_PARAMETERS = 5;
+
+struct ModelFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t model_type;
+    uint64_t count;
+    uint64_t dim;
+    double decision_threshold;
+    uint64_t flags;
+    uint64_t section_offsets[MAX_SECTIONS];
+    uint64_t reserved[2];
+};
+
+static_assert(sizeof(ModelFileHeader) == 128, "model file header must be 128 bytes");
+static_assert(sizeof(unsigned int) == sizeof(uint32_t), "feature indices are stored as uint32");
+static_assert(sizeof(int) == sizeof(int32_t), "labels are stored as int32");
+
+struct Section
+{
+    Section(const void * data, uint64_t size) : data(data), size(size) {}
+
+    const void * data;
+    uint64_t size;
+};
+
+uint64_t alignSection(uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+ModelFileHeader newHeader(ModelType model_type, uint64_t count)
+{
+    ModelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_FILE_VERSION;
+    header.model_type = model_type;
+    header.count = count;
+    return header;
+}
+
+// writes the header, with the offsets of the sections it is followed by
+void writeModelFile(const string & filename, ModelFileHeader header, const vector<Section> & sections)
+{
+    assert(sections.size() <= MAX_SECTIONS);
+
+    ofstream file(filename.c_str(), ios::binary | ios::trunc);
+    if (!file.is_open())
+        throw runtime_error("Cannot open file: " + filename);
+
+    uint64_t offset = sizeof(header);
+    for (size_t s = 0; s < sections.size(); s++)
+    {
+        offset = alignSection(offset);
+        header.section_offsets[s] = offset;
+        offset += sections[s].size;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    for (size_t s = 0; s < sections.size(); s++)
+    {
+        uint64_t pos = file.tellp();
+        file.write(zeros, header.section_offsets[s] - pos);
+        file.write(static_cast<const char *>(sections[s].data), sections[s].size);
+    }
+
+    if (!file.good())
+        throw runtime_error("Cannot write file: " + filename);
+}
+
+// Memory mapping of a model file whose header has been checked
+class ModelFileReader
+{
+public:
+
+    ModelFileReader(const string & filename, ModelType model_type) :
+        filename(filename),
+        mapping(new MappedFile(filename))
+    {
+        if (mapping->size() < sizeof(header))
+            throw runtime_error("Not a model file: " + filename);
+        memcpy(&header, mapping->data(), sizeof(header));
+
+        if (memcmp(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic)) != 0)
+            throw runtime_error("Not a model file: " + filename);
+        if (header.version != MODEL_FILE_VERSION)
+            throw runtime_error("Unsupported model file version in: " + filename);
+        if (header.model_type != static_cast<uint32_t>(model_type))
+            throw runtime_error("Unexpected type of model in: " + filename);
+    }
+
+    // section 'index', holding 'count' elements of type T
+    template <typename T>
+    const T * section(int index, uint64_t count) const
+    {
+        uint64_t offset = header.section_offsets[index];
+
+        if (offset % SECTION_ALIGNMENT != 0 || offset > mapping->size() ||
+                count > (mapping->size() - offset) / sizeof(T))
+            throw runtime_error("Corrupted model file: " + filename);
+
+        return reinterpret_cast<const T *>(mapping->data() + offset);
+    }
+
+    // throws if a feature index is not below the dimension stored in the header
+    void checkFeatures(const uint32_t * features, uint64_t count) const
+    {
+        for (uint64_t m = 0; m < count; m++)
+            if (features[m] >= header.dim)
+                throw runtime_error("Corrupted model file: " + filename);
+    }
+
+    string filename;
+    shared_ptr<MappedFile> mapping;
+    ModelFileHeader header;
+};
+
+// number of features of the samples the weak learners read
+uint64_t featureDimension(const vector<uint32_t> & features)
+{
+    uint64_t dim = 0;
+    for (size_t m = 0; m < features.size(); m++)
+        dim = max<uint64_t>(dim, features[m] + uint64_t(1));
+    return dim;
+}
+
+// labels on left are stored as int32 in boosted stumps, and as double in naive Bayes parameters
+bool isLabelOnLeft(double label)
+{
+    return label == -1 || label == 1;
+}
+
+}
+
+void SaveModel(const BoostedClassifier & model, const string & filename)
+{
+    int nstumps = model.getNumWeakLearners();
+
+    vector<uint32_t> features(nstumps);
+    vector<double> thresholds(nstumps), left_values(nstumps), right_values(nstumps), weights(nstumps);
+    vector<int32_t> labels_on_left(nstumps);
+
+    for (int m = 0; m < nstumps; m++)
+    {
+        const ThresholdLearner * stump = dynamic_cast<const ThresholdLearner *>(model.getWeakLearner(m));
+        if (stump == nullptr)
+            throw invalid_argument("SaveModel: weak learner " + to_string(m) + " is not a ThresholdLearner");
+
+        // same values as in a StumpEnsemble
+        weights[m] = model.getWeakLearnerWeight(m);
+        features[m] = stump->getFeatureIndex();
+        thresholds[m] = stump->getThreshold();
+        labels_on_left[m] = stump->getLabelOnLeft();
+        left_values[m] = weights[m] * labels_on_left[m];
+        right_values[m] = weights[m] * -labels_on_left[m];
+    }
+
+    ModelFileHeader header = newHeader(MODEL_BOOSTED_STUMPS, nstumps);
+    header.dim = featureDimension(features);
+    header.decision_threshold = model.getDecisionThreshold();
+
+    vector<Section> sections;
+    sections.push_back(Section(features.data(), nstumps * sizeof(uint32_t)));
+    sections.push_back(Section(thresholds.data(), nstumps * sizeof(double)));
+    sections.push_back(Section(left_values.data(), nstumps * sizeof(double)));
+    sections.push_back(Section(right_values.data(), nstumps * sizeof(double)));
+    sections.push_back(Section(weights.data(), nstumps * sizeof(double)));
+    sections.push_back(Section(labels_on_left.data(), nstumps * sizeof(int32_t)));
+
+    if (model.hasSoftCascade())
+    {
+        header.flags |= MODEL_HAS_SOFT_CASCADE;
+        sections.push_back(Section(model.getRejectionThresholds().data(), nstumps * sizeof(double)));
+    }
+
+    writeModelFile(filename, header, sections);
+}
+
+void LoadModel(const string & filename, BoostedClassifier * model)
+{
+    ModelFileReader reader(filename, MODEL_BOOSTED_STUMPS);
+    uint64_t nstumps = reader.header.count;
+
+    const uint32_t * features = reader.section<uint32_t>(0, nstumps);
+    const double * thresholds = reader.section<double>(1, nstumps);
+    const double * weights = reader.section<double>(4, nstumps);
+    const int32_t * labels_on_left = reader.section<int32_t>(5, nstumps);
+
+    reader.checkFeatures(features, nstumps);
+    for (uint64_t m = 0; m < nstumps; m++)
+        if (!isLabelOnLeft(labels_on_left[m]))
+            throw runtime_error("Corrupted model file: " + filename);
+
+    model->weak_learners.clear();
+    model->weak_learners_weights.assign(weights, weights + nstumps);
+    for (uint64_t m = 0; m < nstumps; m++)
+        model->weak_learners.create<ThresholdLearner>(features[m], thresholds[m], labels_on_left[m]);
+
+    model->decision_threshold = reader.header.decision_threshold;
+
+    model->rejection_thresholds.clear();
+    if (reader.header.flags & MODEL_HAS_SOFT_CASCADE)
+    {
+        const double * rejection_thresholds = reader.section<double>(6, nstumps);
+        model->rejection_thresholds.assign(rejection_thresholds, rejection_thresholds + nstumps);
+    }
+}
+
+StumpEnsemble LoadStumpEnsemble(const string & filename)
+{
+    ModelFileReader reader(filename, MODEL_BOOSTED_STUMPS);
+    uint64_t nstumps = reader.header.count;
+
+    const uint32_t * features = reader.section<uint32_t>(0, nstumps);
+    const int32_t * labels_on_left = reader.section<int32_t>(5, nstumps);
+
+    // checked once here, so that scoring does not read past the samples
+    reader.checkFeatures(features, nstumps);
+    for (uint64_t m = 0; m < nstumps; m++)
+        if (!isLabelOnLeft(labels_on_left[m]))
+            throw runtime_error("Corrupted model file: " + filename);
+
+    const double * rejection_thresholds = nullptr;
+    if (reader.header.flags & MODEL_HAS_SOFT_CASCADE)
+        rejection_thresholds = reader.section<double>(6, nstumps);
+
+    return StumpEnsemble(nstumps, reader.header.dim,
+                         features,
+                         reader.section<double>(1, nstumps),
+                         reader.section<double>(2, nstumps),
+                         reader.section<double>(3, nstumps),
+                         rejection_thresholds,
+                         reader.header.decision_threshold,
+                         reader.mapping);
+}
+
+void SaveModel(const NaiveBayesClassifier & model, const string & filename)
+{
+    size_t nlearners = model.weak_learners.size();
+
+    vector<uint32_t> types(nlearners), features(nlearners);
+    vector<double> parameters(nlearners * NAIVE_BAYES_PARAMETERS, 0.0);
+
+    for (size_t m = 0; m < nlearners; m++)
+    {
+        double * learner_parameters = &parameters[m * NAIVE_BAYES_PARAMETERS];
+
+        const ThresholdLearner * stump = dynamic_cast<const ThresholdLearner *>(model.weak_learners[m]);
+        const GaussianLearner * gaussian = dynamic_cast<const GaussianLearner *>(model.weak_learners[m]);
+
+        if (stump != nullptr)
+        {
+            types[m] = WEAK_LEARNER_THRESHOLD;
+            features[m] = stump->getFeatureIndex();
+            learner_parameters[0] = stump->getThreshold();
+            learner_parameters[1] = stump->getLabelOnLeft();
+        }
+        else if (gaussian != nullptr)
+        {
+            types[m] = WEAK_LEARNER_GAUSSIAN;
+            features[m] = gaussian->getFeatureIndex();
+            learner_parameters[0] = gaussian->getPosClassMean();
+            learner_parameters[1] = gaussian->getPosClassVar();
+            learner_parameters[2] = gaussian->getNegClassMean();
+            learner_parameters[3] = gaussian->getNegClassVar();
+            learner_parameters[4] = gaussian->getLogRespShift();
+        }
+        else
+            throw invalid_argument("SaveModel: weak learner " + to_string(m) +
+                                   " is neither a ThresholdLearner nor a GaussianLearner");
+    }
+
+    ModelFileHeader header = newHeader(MODEL_NAIVE_BAYES, nlearners);
+    header.dim = featureDimension(features);
+    header.decision_threshold = model.decision_threshold;
+
+    vector<Section> sections;
+    sections.push_back(Section(types.data(), nlearners * sizeof(uint32_t)));
+    sections.push_back(Section(features.data(), nlearners * sizeof(uint32_t)));
+    sections.push_back(Section(parameters.data(), parameters.size() * sizeof(double)));
+
+    writeModelFile(filename, header, sections);
+}
+
+void LoadModel(const string & filename, NaiveBayesClassifier * model)
+{
+    ModelFileReader reader(filename, MODEL_NAIVE_BAYES);
+    uint64_t nlearners = reader.header.count;
+
+    const uint32_t * types = reader.section<uint32_t>(0, nlearners);
+    const uint32_t * features = reader.section<uint32_t>(1, nlearners);
+    const double * parameters = reader.section<double>(2, nlearners * NAIVE_BAYES_PARAMETERS);
+
+    reader.checkFeatures(features, nlearners);
+
+    vector<Classifier *> weak_learners;
+    for (uint64_t m = 0; m < nlearners; m++)
+    {
+        const double * learner_parameters = parameters + m * NAIVE_BAYES_PARAMETERS;
+
+        if (types[m] == WEAK_LEARNER_THRESHOLD && isLabelOnLeft(learner_parameters[1]))
+            weak_learners.push_back(new ThresholdLearner(features[m], learner_parameters[0],
+                                    static_cast<int>(learner_parameters[1])));
+        else if (types[m] == WEAK_LEARNER_GAUSSIAN)
+            weak_learners.push_back(new GaussianLearner(features[m], learner_parameters[0], learner_parameters[1],
+                                    learner_parameters[2], learner_parameters[3], learner_parameters[4]));
+        else
+        {
+            for (size_t i = 0; i < weak_learners.size(); i++)
+                delete weak_learners[i];
+            throw runtime_error("Corrupted model file: " + filename);
+        }
+    }
+
+    for (size_t m = 0; m < model->weak_learners.size(); m++)
+        delete model->weak_learners[m];
+
+    model->weak_learners.swap(weak_learners);
+    model->decision_threshold = reader.header.decision_threshold;
+}
+
+void SaveModel(const GaussianMixtureModel & model, const string & filename)
+{
+    size_t ngaussians = model.ngaussians, dim = model.dim;
+
+    vector<double> means, diag_covs;
+    for (size_t g = 0; g < ngaussians; g++)
+    {
+        means.insert(means.end(), model.means[g].begin(), model.means[g].begin() + dim);
+        diag_covs.insert(diag_covs.end(), model.diag_covs[g].begin(), model.diag_covs[g].begin() + dim);
+    }
+
+    ModelFileHeader header = newHeader(MODEL_GAUSSIAN_MIXTURE, ngaussians);
+    header.dim = dim;
+
+    vector<Section> sections;
+    sections.push_back(Section(model.weights.data(), ngaussians * sizeof(double)));
+    sections.push_back(Section(means.data(), means.size() * sizeof(double)));
+    sections.push_back(Section(diag_covs.data(), diag_covs.size() * sizeof(double)));
+
+    writeModelFile(filename, header, sections);
+}
+
+void LoadModel(const string & filename, GaussianMixtureModel * model)
+{
+    ModelFileReader reader(filename, MODEL_GAUSSIAN_MIXTURE);
+    uint64_t ngaussians = reader.header.count, dim = reader.header.dim;
+
+    // ngaussians * dim is at most the size of the file, so it does not overflow
+    if (ngaussians == 0 || dim == 0 || ngaussians > reader.mapping->size() || dim > reader.mapping->size() / ngaussians)
+        throw runtime_error("Corrupted model file: " + filename);
+
+    const double * weights = reader.section<double>(0, ngaussians);
+    const double * means = reader.section<double>(1, ngaussians * dim);
+    const double * diag_covs = reader.section<double>(2, ngaussians * dim);
+
+    model->ngaussians = ngaussians;
+    model->dim = dim;
+    model->pi_const = 0.5 * dim * log(M_PI);
+    model->weights.assign(weights, weights + ngaussians);
+    model->means.resize(ngaussians);
+    model->diag_covs.resize(ngaussians);
+    model->log_sqrt_determinants.resize(ngaussians);
+
+    for (uint64_t g = 0; g < ngaussians; g++)
+    {
+        model->means[g].assign(means + g * dim, means + (g + 1) * dim);
+        model->diag_covs[g].assign(diag_covs + g * dim, diag_covs + (g + 1) * dim);
+        model->log_sqrt_determinants[g] = model->log_sqrt_determinant(g);
+    }
+}
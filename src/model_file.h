@@ -0,0 +1,81 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MODEL_FILE_H_
+#define MODEL_FILE_H_
+
+#include <string>
+
+#include "boosted_classifier.h"
+#include "gaussian_mixture_model.h"
+#include "naive_bayes_classifier.h"
+#include "stump_ensemble.h"
+
+// Binary model format (version 2), in native (little-endian) byte order:
+//
+//   header   128 bytes: magic "LAKEMLMD", uint32 version, uint32 model type,
+//            uint64 count, uint64 dimension, double decision threshold,
+//            uint64 flags, and the uint64 byte offsets of up to 8 sections
+//   sections arrays whose content depends on the model type:
+//
+//   MODEL_BOOSTED_STUMPS      count = number of stumps, dimension = 1 + the largest feature index
+//     0 uint32 feature indices, 1 double thresholds, 2 double left values,
+//     3 double right values (see StumpEnsemble), 4 double weak learner weights,
+//     5 int32 labels on left (-1 or 1), 6 double rejection thresholds (only if flags
+//     has MODEL_HAS_SOFT_CASCADE)
+//   MODEL_NAIVE_BAYES         count = number of weak learners, dimension as for boosted stumps
+//     0 uint32 weak learner types (WEAK_LEARNER_*), 1 uint32 feature indices,
+//     2 double parameters, 5 per weak learner (threshold and label on left,
+//     or the means, variances and response shift of a GaussianLearner)
+//   MODEL_GAUSSIAN_MIXTURE    count = number of gaussians
+//     0 double mixing weights, 1 double means, 2 double diagonal covariances
+//     (one row of 'dimension' values per gaussian)
+//
+// Every section starts at a 64-byte aligned offset, so it can be used in place
+// from a memory mapping of the file.
+
+const unsigned int MODEL_FILE_VERSION = 2;
+
+enum ModelType { MODEL_BOOSTED_STUMPS = 1, MODEL_NAIVE_BAYES = 2, MODEL_GAUSSIAN_MIXTURE = 3 };
+enum WeakLearnerType { WEAK_LEARNER_THRESHOLD = 1, WEAK_LEARNER_GAUSSIAN = 2 };
+
+const unsigned int MODEL_HAS_SOFT_CASCADE = 1;
+
+// Write a trained model to 'filename'. Throws std::runtime_error if the file can not be
+// written, and std::invalid_argument if the model has weak learners that can not be stored
+// (boosted classifiers: only ThresholdLearner; naive Bayes: ThresholdLearner or GaussianLearner).
+void SaveModel(const BoostedClassifier & model, const std::string & filename);
+void SaveModel(const NaiveBayesClassifier & model, const std::string & filename);
+void SaveModel(const GaussianMixtureModel & model, const std::string & filename);
+
+// Replace the trained state of 'model' by the one stored in 'filename'. The loaded model
+// can classify, but keeps the training parameters it was constructed with.
+// Throws std::runtime_error if the file can not be read or does not hold that type of model,
+// or if a label or feature index is out of range.
+void LoadModel(const std::string & filename, BoostedClassifier * model);
+void LoadModel(const std::string & filename, NaiveBayesClassifier * model);
+void LoadModel(const std::string & filename, GaussianMixtureModel * model);
+
+// Maps a boosted stumps model file into memory and returns an ensemble that reads its
+// arrays directly from the mapping: loading takes the same time whatever the size of the
+// model, and processes loading the same file share one copy of it.
+// Throws std::runtime_error if the file can not be read or does not hold boosted stumps.
+StumpEnsemble LoadStumpEnsemble(const std::string & filename);
+
+#endif  // MODEL_FILE_H_
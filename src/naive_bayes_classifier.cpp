@@ -83,7 +83,7 @@ void NaiveBayesClassifier::train(const Dataset & training_dataset, const vector<
     }
 }
 
-double NaiveBayesClassifier::response(const DataInstance & data_instance) const
+double NaiveBayesClassifier::response(const DataRow & data_instance) const
 {
     double resp = 0.0;
     int valid_responses = 0;
@@ -104,7 +104,7 @@ double NaiveBayesClassifier::response(const DataInstance & data_instance) const
     return resp / valid_responses;
 }
 
-int NaiveBayesClassifier::classify(const DataInstance & data_instance) const
+int NaiveBayesClassifier::classify(const DataRow & data_instance) const
 {
     double resp = response(data_instance);
 
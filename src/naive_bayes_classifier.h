@@ -18,6 +18,7 @@
 */
 
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "classifier.h"
@@ -38,11 +39,14 @@ public:
 
     // declared virtual in Classifier
     void   train(const Dataset & training_dataset, const std::vector<double> &weights);
-    double response(const DataInstance & data_instance) const;
-    int    classify(const DataInstance & data_instance) const;
+    double response(const DataRow & data_instance) const;
+    int    classify(const DataRow & data_instance) const;
 
 private:
 
+    friend void SaveModel(const NaiveBayesClassifier & model, const std::string & filename);
+    friend void LoadModel(const std::string & filename, NaiveBayesClassifier * model);
+
     const ClassifierFactory * classifier_factory;
     int learners_to_add;
 
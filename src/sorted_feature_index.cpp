@@ -0,0 +1,89 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+#include "sorted_feature_index.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+SortedFeatureIndex::SortedFeatureIndex(const Dataset & dataset, int nthreads) :
+    nsamples(dataset.size()),
+    dim(dataset.dimension()),
+    finite_counts(dim),
+    indices(dim * nsamples),
+    values(dim * nsamples)
+{
+    ThreadPool pool(nthreads);
+    vector< vector< pair<double, unsigned int> > > feature_vals(pool.size());
+
+    pool.run(dim, [&](size_t d, int worker) {
+        FeatureColumn column = dataset.column(d);
+        vector< pair<double, unsigned int> > & sorted = feature_vals[worker];
+
+        sorted.clear();
+        for (size_t i = 0; i < nsamples; i++)
+            if (isfinite(column[i]))
+                sorted.push_back(pair<double, unsigned int>(column[i], i));
+
+        sort(sorted.begin(), sorted.end());
+
+        finite_counts[d] = sorted.size();
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            values[d * nsamples + i] = sorted[i].first;
+            indices[d * nsamples + i] = sorted[i].second;
+        }
+    });
+}
+
+size_t SortedFeatureIndex::dimension() const
+{
+    return dim;
+}
+
+size_t SortedFeatureIndex::size(size_t feature_index) const
+{
+    assert(feature_index < dim);
+    return finite_counts[feature_index];
+}
+
+const unsigned int * SortedFeatureIndex::sampleIndices(size_t feature_index) const
+{
+    assert(feature_index < dim);
+    return indices.data() + feature_index * nsamples;
+}
+
+const double * SortedFeatureIndex::sortedValues(size_t feature_index) const
+{
+    assert(feature_index < dim);
+    return values.data() + feature_index * nsamples;
+}
+
+const SortedFeatureIndex & CacheSortedFeatureIndex(const Dataset & dataset, int nthreads)
+{
+    if (!dataset.sorted_index)
+        dataset.sorted_index.reset(new SortedFeatureIndex(dataset, nthreads));
+
+    return *dataset.sorted_index;
+}
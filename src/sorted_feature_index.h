@@ -0,0 +1,63 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SORTED_FEATURE_INDEX_H_
+#define SORTED_FEATURE_INDEX_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "dataset.h"
+
+/// Order of the samples of a dataset along each of its features, so that learners
+/// searching for splits (e.g. ThresholdLearner) scan it instead of sorting each time
+/// they are trained. Samples whose value is not finite are left out.
+/// Takes 12 bytes per value of the dataset.
+class SortedFeatureIndex
+{
+public:
+
+    // sorts the features of 'dataset' in parallel with 'nthreads' threads (one per core if <= 0)
+    explicit SortedFeatureIndex(const Dataset & dataset, int nthreads = 0);
+
+    size_t dimension() const;
+
+    // number of samples with a finite value of the feature
+    size_t size(size_t feature_index) const;
+
+    // indices of these samples, by increasing value of the feature (ties by increasing index)
+    const unsigned int * sampleIndices(size_t feature_index) const;
+
+    // their values of the feature, in the same order
+    const double * sortedValues(size_t feature_index) const;
+
+private:
+
+    size_t nsamples, dim;
+    std::vector<size_t> finite_counts;
+    std::vector<unsigned int> indices;     // feature d starts at d * nsamples
+    std::vector<double> values;
+};
+
+// Returns the index cached in 'dataset', computing it first if the dataset has none.
+// The cache is shared by copies of the dataset and dropped when it is modified.
+// The first call must not run concurrently with other uses of the dataset.
+const SortedFeatureIndex & CacheSortedFeatureIndex(const Dataset & dataset, int nthreads = 0);
+
+#endif  // SORTED_FEATURE_INDEX_H_
@@ -0,0 +1,302 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define STUMP_ENSEMBLE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "stump_ensemble.h"
+#include "threshold_learner.h"
+
+using namespace std;
+
+// Kernels adding the values of one stump to the responses out[0, n) of samples whose feature
+// values are values[0, n). All follow the rule of StumpEnsemble::response() to the bit.
+typedef void (*StumpKernel)(const double * values, size_t n, double threshold,
+                            double left, double right, double * out);
+
+static void AddStumpScalar(const double * values, size_t n, double threshold,
+                           double left, double right, double * out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        double diff = values[i] - threshold;
+        double value = (diff < 0) ? left : right;
+        out[i] += isfinite(diff) ? value : 0.0;
+    }
+}
+
+#ifdef STUMP_ENSEMBLE_X86_KERNELS
+
+__attribute__((target("avx2")))
+static void AddStumpAvx2(const double * values, size_t n, double threshold,
+                         double left, double right, double * out)
+{
+    const __m256d thresholds = _mm256_set1_pd(threshold);
+    const __m256d lefts = _mm256_set1_pd(left), rights = _mm256_set1_pd(right);
+    const __m256d zeros = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(values + i), thresholds);
+        __m256d value = _mm256_blendv_pd(rights, lefts, _mm256_cmp_pd(diff, zeros, _CMP_LT_OQ));
+
+        // diff - diff is 0 only if diff is finite
+        __m256d finite = _mm256_cmp_pd(_mm256_sub_pd(diff, diff), zeros, _CMP_EQ_OQ);
+        value = _mm256_and_pd(value, finite);
+
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(out + i), value));
+    }
+
+    AddStumpScalar(values + i, n - i, threshold, left, right, out + i);
+}
+
+__attribute__((target("avx512f")))
+static void AddStumpAvx512(const double * values, size_t n, double threshold,
+                           double left, double right, double * out)
+{
+    const __m512d thresholds = _mm512_set1_pd(threshold);
+    const __m512d lefts = _mm512_set1_pd(left), rights = _mm512_set1_pd(right);
+    const __m512d zeros = _mm512_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(values + i), thresholds);
+        __m512d value = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(diff, zeros, _CMP_LT_OQ), rights, lefts);
+        __mmask8 finite = _mm512_cmp_pd_mask(_mm512_sub_pd(diff, diff), zeros, _CMP_EQ_OQ);
+
+        __m512d sums = _mm512_loadu_pd(out + i);
+        _mm512_storeu_pd(out + i, _mm512_mask_add_pd(sums, finite, sums, value));
+    }
+
+    AddStumpScalar(values + i, n - i, threshold, left, right, out + i);
+}
+
+#endif  // STUMP_ENSEMBLE_X86_KERNELS
+
+static StumpKernel SelectStumpKernel(SimdLevel level)
+{
+#ifdef STUMP_ENSEMBLE_X86_KERNELS
+    if (level == SIMD_AVX512)
+        return AddStumpAvx512;
+    if (level == SIMD_AVX2)
+        return AddStumpAvx2;
+#endif
+    return AddStumpScalar;
+}
+
+namespace
+{
+
+// storage of an ensemble compiled from a BoostedClassifier
+struct StumpArrays
+{
+    vector<unsigned int> features;
+    vector<double> thresholds, left_values, right_values, rejection_thresholds;
+};
+
+}
+
+StumpEnsemble::StumpEnsemble() :
+    nstumps(0),
+    dim(0),
+    features(nullptr),
+    thresholds(nullptr),
+    left_values(nullptr),
+    right_values(nullptr),
+    rejection_thresholds(nullptr),
+    decision_threshold(0),
+    simd_level(DetectSimdLevel())
+{
+}
+
+StumpEnsemble::StumpEnsemble(const BoostedClassifier & classifier) :
+    nstumps(classifier.getNumWeakLearners()),
+    dim(0),
+    decision_threshold(classifier.getDecisionThreshold()),
+    simd_level(DetectSimdLevel())
+{
+    shared_ptr<StumpArrays> arrays(new StumpArrays());
+
+    arrays->features.reserve(nstumps);
+    arrays->thresholds.reserve(nstumps);
+    arrays->left_values.reserve(nstumps);
+    arrays->right_values.reserve(nstumps);
+
+    for (size_t m = 0; m < nstumps; m++)
+    {
+        const ThresholdLearner * stump = dynamic_cast<const ThresholdLearner *>(classifier.getWeakLearner(m));
+        if (stump == nullptr)
+            throw invalid_argument("StumpEnsemble: weak learner " + to_string(m) + " is not a ThresholdLearner");
+
+        double weight = classifier.getWeakLearnerWeight(m);
+
+        arrays->features.push_back(stump->getFeatureIndex());
+        dim = max<size_t>(dim, stump->getFeatureIndex() + 1);
+        arrays->thresholds.push_back(stump->getThreshold());
+        arrays->left_values.push_back(weight * stump->getLabelOnLeft());
+        arrays->right_values.push_back(weight * -stump->getLabelOnLeft());
+    }
+
+    arrays->rejection_thresholds = classifier.getRejectionThresholds();
+
+    features = arrays->features.data();
+    thresholds = arrays->thresholds.data();
+    left_values = arrays->left_values.data();
+    right_values = arrays->right_values.data();
+    rejection_thresholds = arrays->rejection_thresholds.empty() ? nullptr : arrays->rejection_thresholds.data();
+    storage = arrays;
+}
+
+StumpEnsemble::StumpEnsemble(size_t nstumps, size_t dim, const unsigned int * features, const double * thresholds,
+                             const double * left_values, const double * right_values,
+                             const double * rejection_thresholds, double decision_threshold,
+                             const shared_ptr<const void> & owner) :
+    nstumps(nstumps),
+    dim(dim),
+    features(features),
+    thresholds(thresholds),
+    left_values(left_values),
+    right_values(right_values),
+    rejection_thresholds(rejection_thresholds),
+    decision_threshold(decision_threshold),
+    storage(owner),
+    simd_level(DetectSimdLevel())
+{
+}
+
+size_t StumpEnsemble::size() const
+{
+    return nstumps;
+}
+
+size_t StumpEnsemble::dimension() const
+{
+    return dim;
+}
+
+double StumpEnsemble::response(const DataRow & data_instance) const
+{
+    assert(data_instance.size() >= dim);
+
+    const unsigned int * feature = features;
+    const double * threshold = thresholds;
+    const double * left = left_values;
+    const double * right = right_values;
+
+    double resp = 0.0;
+
+    for (size_t m = 0; m < nstumps; m++)
+    {
+        // same rule as ThresholdLearner::classify, with selects instead of branches
+        double diff = data_instance[feature[m]] - threshold[m];
+        double value = (diff < 0) ? left[m] : right[m];
+        resp += isfinite(diff) ? value : 0.0;
+    }
+
+    return resp;
+}
+
+int StumpEnsemble::classify(const DataRow & data_instance) const
+{
+    return classify(data_instance, nullptr);
+}
+
+int StumpEnsemble::classify(const DataRow & data_instance, int * out_nb_evaluated) const
+{
+    assert(data_instance.size() >= dim);
+
+    double resp;
+
+    if (rejection_thresholds == nullptr)
+        resp = response(data_instance);
+    else
+    {
+        resp = 0.0;
+
+        for (size_t m = 0; m < nstumps; m++)
+        {
+            double diff = data_instance[features[m]] - thresholds[m];
+            double value = (diff < 0) ? left_values[m] : right_values[m];
+            resp += isfinite(diff) ? value : 0.0;
+
+            if (resp < rejection_thresholds[m])
+            {
+                if (out_nb_evaluated != nullptr)
+                    *out_nb_evaluated = m + 1;
+                return -1;
+            }
+        }
+    }
+
+    if (out_nb_evaluated != nullptr)
+        *out_nb_evaluated = nstumps;
+
+    return ((resp <= decision_threshold) ? -1 : 1);
+}
+
+void StumpEnsemble::response(const Dataset & dataset, size_t first_sample, size_t nsamples, double * out) const
+{
+    assert(first_sample + nsamples <= dataset.size());
+    assert(dataset.dimension() >= dim || nsamples == 0);
+
+    // blocks small enough for their responses (and gathered features) to stay in L1 cache
+    const size_t BLOCK_SIZE = 256;
+    double gathered[BLOCK_SIZE];
+
+    StumpKernel add_stump = SelectStumpKernel(simd_level);
+
+    for (size_t block = 0; block < nsamples; block += BLOCK_SIZE)
+    {
+        size_t block_size = min(BLOCK_SIZE, nsamples - block);
+        double * block_out = out + block;
+        fill(block_out, block_out + block_size, 0.0);
+
+        for (size_t m = 0; m < nstumps; m++)
+        {
+            FeatureColumn column = dataset.column(features[m]);
+            const double * values;
+
+            if (column.isContiguous())
+                values = column.data() + first_sample + block;
+            else
+            {
+                for (size_t i = 0; i < block_size; i++)
+                    gathered[i] = column[first_sample + block + i];
+                values = gathered;
+            }
+
+            add_stump(values, block_size, thresholds[m], left_values[m], right_values[m], block_out);
+        }
+    }
+}
+
+void StumpEnsemble::setSimdLevel(SimdLevel level)
+{
+    simd_level = min(level, DetectSimdLevel());
+}
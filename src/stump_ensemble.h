@@ -0,0 +1,91 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STUMP_ENSEMBLE_H_
+#define STUMP_ENSEMBLE_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "boosted_classifier.h"
+#include "cpu_features.h"
+#include "dataset.h"
+
+/// BoostedClassifier of decision stumps (ThresholdLearner) compiled into flat arrays, one
+/// entry per stump, for fast scoring: no virtual call nor pointer to follow per stump.
+/// Responses and classes are exactly those of the boosted classifier it was built from.
+class StumpEnsemble
+{
+public:
+
+    StumpEnsemble();
+
+    // throws std::invalid_argument if a weak learner of 'classifier' is not a ThresholdLearner
+    explicit StumpEnsemble(const BoostedClassifier & classifier);
+
+    // Ensemble over arrays of 'nstumps' entries stored elsewhere (e.g. in a memory-mapped model
+    // file, see LoadStumpEnsemble), which are used in place, without a copy. 'owner' keeps them
+    // alive for as long as this ensemble (or a copy of it) exists. rejection_thresholds may be null.
+    // The feature indices must be below 'dim'.
+    StumpEnsemble(size_t nstumps, size_t dim, const unsigned int * features, const double * thresholds,
+                  const double * left_values, const double * right_values,
+                  const double * rejection_thresholds, double decision_threshold,
+                  const std::shared_ptr<const void> & owner);
+
+    // number of stumps
+    size_t size() const;
+
+    // number of features the samples scored must have (1 + the largest feature index)
+    size_t dimension() const;
+
+    double response(const DataRow & data_instance) const;
+    int    classify(const DataRow & data_instance) const;
+
+    // classify, reporting in 'out_nb_evaluated' how many stumps were evaluated (fewer than size()
+    // when the soft cascade of the boosted classifier, if calibrated, rejects the sample early)
+    int    classify(const DataRow & data_instance, int * out_nb_evaluated) const;
+
+    // Responses of samples [first_sample, first_sample + nsamples) of 'dataset' written to
+    // out[0, nsamples). Evaluates each stump on blocks of samples with the vector instructions
+    // of the CPU; fastest on column-major datasets. Results equal response() exactly.
+    void response(const Dataset & dataset, size_t first_sample, size_t nsamples, double * out) const;
+
+    // Highest instruction set used by the batch response (default and maximum: DetectSimdLevel())
+    void setSimdLevel(SimdLevel level);
+
+private:
+
+    // stump m adds left_values[m] if feature features[m] is below thresholds[m],
+    // right_values[m] otherwise, and 0 if the feature (or its difference to the threshold)
+    // is not finite. The values are the stump weight times the class on each side.
+    size_t nstumps, dim;
+    const unsigned int * features;
+    const double * thresholds;
+    const double * left_values;
+    const double * right_values;
+    const double * rejection_thresholds;   // see BoostedClassifier::calibrateSoftCascade, or null
+    double decision_threshold;
+
+    // the arrays above are immutable, so copies of the ensemble share them
+    std::shared_ptr<const void> storage;
+    SimdLevel simd_level;
+};
+
+#endif  // STUMP_ENSEMBLE_H_
@@ -0,0 +1,134 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int nthreads) :
+    current_task(nullptr), task_count(0), next_task(0), generation(0), busy_workers(0),
+    stopping(false)
+{
+    if (nthreads <= 0)
+        nthreads = thread::hardware_concurrency();
+    if (nthreads <= 0)
+        nthreads = 1;
+
+    // worker 0 is the thread calling run()
+    for (int worker = 1; worker < nthreads; worker++)
+        threads.push_back(thread(&ThreadPool::workerLoop, this, worker));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(state_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
+int ThreadPool::size() const
+{
+    return threads.size() + 1;
+}
+
+void ThreadPool::run(size_t ntasks, const function<void(size_t, int)> & task)
+{
+    if (threads.empty() || ntasks <= 1)
+    {
+        for (size_t index = 0; index < ntasks; index++)
+            task(index, 0);
+        return;
+    }
+
+    lock_guard<mutex> run_lock(run_mutex);
+
+    {
+        lock_guard<mutex> lock(state_mutex);
+        current_task = &task;
+        task_count = ntasks;
+        next_task = 0;
+        busy_workers = threads.size();
+        first_error = exception_ptr();
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    unique_lock<mutex> lock(state_mutex);
+    while (busy_workers > 0)
+        done.wait(lock);
+
+    current_task = nullptr;
+
+    if (first_error)
+        rethrow_exception(first_error);
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    size_t seen_generation = 0;
+
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(state_mutex);
+            while (!stopping && generation == seen_generation)
+                wake.wait(lock);
+
+            if (stopping)
+                return;
+
+            seen_generation = generation;
+        }
+
+        work(worker);
+
+        lock_guard<mutex> lock(state_mutex);
+        if (--busy_workers == 0)
+            done.notify_one();
+    }
+}
+
+void ThreadPool::work(int worker)
+{
+    for (;;)
+    {
+        size_t index = next_task++;
+        if (index >= task_count)
+            return;
+
+        try
+        {
+            (*current_task)(index, worker);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(state_mutex);
+            if (!first_error)
+                first_error = current_exception();
+            next_task = task_count;     // skip the remaining tasks
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of threads that run the iterations of a loop in parallel.
+/// The thread calling run() takes part in the work, so a pool of size 1 has no extra thread.
+class ThreadPool
+{
+public:
+
+    // nthreads <= 0 uses one thread per hardware core
+    explicit ThreadPool(int nthreads = 0);
+    ~ThreadPool();
+
+    int size() const;
+
+    // Calls task(index, worker) once for every index in [0, ntasks), in no particular order,
+    // and returns when all calls have returned. 'worker' is in [0, size()) and identifies the
+    // calling thread, e.g. to select per-thread buffers. If a call throws, the remaining
+    // indices are skipped and the first exception is rethrown here.
+    // Must not be called from inside a task.
+    void run(size_t ntasks, const std::function<void(size_t, int)> & task);
+
+private:
+
+    // not copyable
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator=(const ThreadPool &);
+
+    void workerLoop(int worker);
+    void work(int worker);
+
+    std::vector<std::thread> threads;
+
+    std::mutex run_mutex;           // serializes calls to run()
+    std::mutex state_mutex;
+    std::condition_variable wake, done;
+
+    const std::function<void(size_t, int)> * current_task;
+    size_t task_count;
+    std::atomic<size_t> next_task;
+    size_t generation;
+    int busy_workers;
+    bool stopping;
+    std::exception_ptr first_error;
+};
+
+#endif  // THREAD_POOL_H_
@@ -20,75 +20,249 @@
 #include <algorithm>
 #include <cmath>
 #include <float.h>
+#include <memory>
 
+#include "binned_features.h"
 #include "math_utils.h"
+#include "sorted_feature_index.h"
 #include "threshold_learner.h"
 
 using namespace std;
 
-ThresholdLearner::ThresholdLearner()
+ThresholdLearner::ThresholdLearner() :
+    split_search(EXACT)
 {
 }
 
-ThresholdLearner::ThresholdLearner( unsigned int feature_index) :
+ThresholdLearner::ThresholdLearner( unsigned int feature_index, SplitSearch split_search) :
     feature_index(feature_index),
+    split_search(split_search),
     optimal_threshold(0),
     label_on_left(-1)
 {
 }
 
+ThresholdLearner::ThresholdLearner( unsigned int feature_index, double threshold, int label_on_left) :
+    feature_index(feature_index),
+    split_search(EXACT),
+    optimal_threshold(threshold),
+    label_on_left(label_on_left)
+{
+}
+
+
+void ThresholdLearner::prepareTraining(const Dataset & training_dataset, int nthreads) const
+{
+    if (split_search == HISTOGRAM)
+        CacheBinnedFeatures(training_dataset, nthreads);
+    else
+        CacheSortedFeatureIndex(training_dataset, nthreads);
+}
 
 void ThresholdLearner::train(const Dataset & training_dataset, const vector<double> &all_data_weights)
 {
     assert(training_dataset.size() > 0);
     assert(training_dataset.size() == all_data_weights.size());
 
-    vector< pair<double, int> > feature_vals;
+    if (split_search == HISTOGRAM)
+        trainHistogram(training_dataset, all_data_weights);
+    else
+        trainExact(training_dataset, all_data_weights);
+}
+
+void ThresholdLearner::trainHistogram(const Dataset & training_dataset, const vector<double> &all_data_weights)
+{
+    // without bins cached in the dataset (see prepareTraining), only this feature is binned
+    const BinnedFeatures * binned_features = training_dataset.binnedFeatures();
+    shared_ptr<BinnedFeatures> local_bins;
+    if (binned_features == nullptr)
+    {
+        local_bins.reset(new BinnedFeatures(BinnedFeatures::singleFeature(training_dataset, feature_index)));
+        binned_features = local_bins.get();
+    }
+
+    // weights of each class in each bin
+    size_t nbins = binned_features->numBins(feature_index);
+    vector<double> negative_weights(nbins, 0.0), positive_weights(nbins, 0.0);
+    double negative_weight = 0, positive_weight = 0;
+
+    const uint8_t * codes = binned_features->binCodes(feature_index);
+    for (unsigned int i = 0; i < training_dataset.size(); i++)
+    {
+        if (codes[i] == BinnedFeatures::MISSING)   // discard samples where feature is N.A.
+            continue;
+
+        if (training_dataset.getLabelAt(i) < 0)
+            negative_weights[codes[i]] += all_data_weights[i];
+        else
+            positive_weights[codes[i]] += all_data_weights[i];
+    }
+
+    for (size_t b = 0; b < nbins; b++)
+    {
+        negative_weight += negative_weights[b];
+        positive_weight += positive_weights[b];
+    }
+
+    if (nbins == 0)
+    {
+        // no sample has the feature, see findBestSplit
+        optimal_threshold = 0.0;
+        label_on_left = 1;
+        return;
+    }
+
+    // start with every sample on the right of the first edge
+    double false_positives_if_inc = negative_weight, false_negatives_if_inc = 0;      // negatives on the left
+    double false_positives_if_dec = 0, false_negatives_if_dec = positive_weight;      // positives on the left
+    double min_error;
+
+    optimal_threshold = binned_features->lowerEdge(feature_index, 0);
+
+    if (false_positives_if_inc < false_negatives_if_dec)
+    {
+        min_error = false_positives_if_inc;
+        label_on_left = -1;
+    }
+    else
+    {
+        min_error = false_negatives_if_dec;
+        label_on_left = 1;
+    }
+
+    // threshold at the lower edge of bin b: bins before it are on the left
+    for (size_t b = 1; b < nbins; b++)
+    {
+        false_positives_if_inc -= negative_weights[b - 1];
+        false_positives_if_dec += negative_weights[b - 1];
+        false_negatives_if_inc += positive_weights[b - 1];
+        false_negatives_if_dec -= positive_weights[b - 1];
+
+        double error_if_inc = false_positives_if_inc + false_negatives_if_inc;
+        double error_if_dec = false_positives_if_dec + false_negatives_if_dec;
+
+        if (error_if_inc < min_error)
+        {
+            label_on_left = -1;
+            min_error = error_if_inc;
+            optimal_threshold = binned_features->lowerEdge(feature_index, b);
+        }
+
+        if (error_if_dec < min_error)
+        {
+            label_on_left = 1;
+            min_error = error_if_dec;
+            optimal_threshold = binned_features->lowerEdge(feature_index, b);
+        }
+    }
+}
+
+void ThresholdLearner::trainExact(const Dataset & training_dataset, const vector<double> &all_data_weights)
+{
+    const SortedFeatureIndex * sorted_index = training_dataset.sortedIndex();
+    if (sorted_index != nullptr)
+    {
+        vector<int> labels(training_dataset.size());
+        for (unsigned int i = 0; i < training_dataset.size(); i++)
+            labels[i] = training_dataset.getLabelAt(i);
+
+        train(training_dataset, *sorted_index, labels, all_data_weights);
+        return;
+    }
+
+    FeatureColumn feature_column = training_dataset.column(feature_index);
+    double negative_weight = 0, positive_weight = 0;
+
+    vector< pair<double, unsigned int> > feature_vals;
     vector<int> true_labels;
     vector<double> data_weights;
 
-    double min_error = DBL_MAX;
-
     // compute feature (real-valued number) for each data sample
-    int nsamples = 0;
+    unsigned int nsamples = 0;
     for (unsigned int i = 0; i < training_dataset.size(); i++)
     {
-        double fval = training_dataset[i][feature_index];
+        double fval = feature_column[i];
 
         if (isfinite(fval) )  // discard samples where feature is N.A.
         {
-            feature_vals.push_back( pair<double, int>(fval, nsamples));
+            feature_vals.push_back( pair<double, unsigned int>(fval, nsamples));
             true_labels.push_back(training_dataset.getLabelAt(i));
             data_weights.push_back(all_data_weights[i]);
             nsamples++;
 
+            if (true_labels.back() < 0)
+                negative_weight += data_weights.back();
+            else
+                positive_weight += data_weights.back();
+        }
+    }
+
+    // sort according to feature value
+    sort(feature_vals.begin(), feature_vals.end());
+
+    vector<double> sorted_values(nsamples);
+    vector<unsigned int> order(nsamples);
+    for (unsigned int i = 0; i < nsamples; i++)
+    {
+        sorted_values[i] = feature_vals[i].first;
+        order[i] = feature_vals[i].second;
+    }
+
+    findBestSplit(sorted_values.data(), order.data(), nsamples, true_labels.data(), data_weights.data(),
+                  negative_weight, positive_weight);
+}
+
+void ThresholdLearner::train(const Dataset & training_dataset, const SortedFeatureIndex & sorted_index,
+                             const vector<int> & labels, const vector<double> &all_data_weights)
+{
+    assert(labels.size() == training_dataset.size());
+    assert(all_data_weights.size() == training_dataset.size());
+
+    // samples are already sorted, only the class weights have to be summed
+    FeatureColumn feature_column = training_dataset.column(feature_index);
+    double negative_weight = 0, positive_weight = 0;
+
+    for (unsigned int i = 0; i < training_dataset.size(); i++)
+    {
+        if (isfinite(feature_column[i]))
+        {
+            if (labels[i] < 0)
+                negative_weight += all_data_weights[i];
+            else
+                positive_weight += all_data_weights[i];
         }
     }
 
-    if ( nsamples == 0)
+    findBestSplit(sorted_index.sortedValues(feature_index), sorted_index.sampleIndices(feature_index),
+                  sorted_index.size(feature_index), labels.data(), all_data_weights.data(),
+                  negative_weight, positive_weight);
+}
+
+void ThresholdLearner::findBestSplit(const double * sorted_values, const unsigned int * order, size_t nsamples,
+                                     const int * labels, const double * weights,
+                                     double negative_weight, double positive_weight)
+{
+    // samples of zero weight are skipped, as if they were not in the dataset (e.g. the samples
+    // a boosting round leaves out), so that the sorted index of the whole dataset can be scanned
+    size_t first = 0;
+    while (first < nsamples && weights[order[first]] == 0.0)
+        first++;
+
+    if ( first == nsamples)
     {
         // put arbitrary values and exit (it will not be selected anyways and
         // even if it was classifier would respond always zero)
-        min_error = DBL_MAX;
         optimal_threshold = 0.0;
         label_on_left = 1;
         return;
     }
 
-    // sort according to feature value
-    sort(feature_vals.begin(), feature_vals.end());
-
     // initialize variables
-    double false_positives_if_inc = 0, false_negatives_if_inc = 0;      // if negatives are on the left of decision threshold (increasing -1 : 1)
-    double false_positives_if_dec = 0, false_negatives_if_dec = 0;      // if positives are on the left of decision threshold (decreasing 1 : -1)
-
-    for (int i = 0; i < nsamples; i++)
-        if ( true_labels[i] < 0)
-            false_positives_if_inc += data_weights[i];
-        else
-            false_negatives_if_dec += data_weights[i];
+    double false_positives_if_inc = negative_weight, false_negatives_if_inc = 0;      // if negatives are on the left of decision threshold (increasing -1 : 1)
+    double false_positives_if_dec = 0, false_negatives_if_dec = positive_weight;      // if positives are on the left of decision threshold (decreasing 1 : -1)
+    double min_error;
 
-    optimal_threshold = feature_vals[0].first;
+    optimal_threshold = sorted_values[first];
 
 
     if (false_positives_if_inc < false_negatives_if_dec)
@@ -104,22 +278,24 @@ void ThresholdLearner::train(const Dataset & training_dataset, const vector<doub
 
 
     // find split of minimum error
-    for (int i = 1; i < nsamples; i++)
+    for (size_t i = first + 1; i < nsamples; i++)
     {
-        int curr_ind = feature_vals[i].second;
+        unsigned int curr_ind = order[i];
+        if (weights[curr_ind] == 0.0)
+            continue;
 
-        if (true_labels[curr_ind] < 0)
+        if (labels[curr_ind] < 0)
         {
-            false_positives_if_inc -= data_weights[curr_ind];
-            false_positives_if_dec += data_weights[curr_ind];
+            false_positives_if_inc -= weights[curr_ind];
+            false_positives_if_dec += weights[curr_ind];
         }
         else
         {
-            false_negatives_if_inc += data_weights[curr_ind];
-            false_negatives_if_dec -= data_weights[curr_ind];
+            false_negatives_if_inc += weights[curr_ind];
+            false_negatives_if_dec -= weights[curr_ind];
         }
 
-        if ( (feature_vals[i].first > optimal_threshold) )  // otherwise can not use this value to split between samples
+        if ( (sorted_values[i] > optimal_threshold) )  // otherwise can not use this value to split between samples
         {
             double error_if_inc = false_positives_if_inc + false_negatives_if_inc;
             double error_if_dec = false_positives_if_dec + false_negatives_if_dec;
@@ -128,39 +304,15 @@ void ThresholdLearner::train(const Dataset & training_dataset, const vector<doub
             {
                 label_on_left = -1;
                 min_error = error_if_inc;
-                optimal_threshold = feature_vals[i].first;
+                optimal_threshold = sorted_values[i];
             }
 
             if (error_if_dec < min_error)
             {
                 label_on_left = 1;
                 min_error = error_if_dec;
-                optimal_threshold = feature_vals[i].first;
+                optimal_threshold = sorted_values[i];
             }
         }
     }
 }
-
-
-double ThresholdLearner::response(const DataInstance & data_instance) const
-{
-    double fval = data_instance[feature_index];
-
-    if (!isfinite(fval))
-        return fval;
-
-    return (fval - optimal_threshold);
-}
-
-int ThresholdLearner::classify(const DataInstance & data_instance) const
-{
-    double resp = response(data_instance);
-
-    if (!isfinite(resp)) return 0;
-
-    return (resp < 0) ? label_on_left : -label_on_left;
-
-}
-
-
-
@@ -20,23 +20,75 @@
 #ifndef THRLRN
 #define THRLRN
 
+#include <cmath>
+
 #include "classifier.h"
 
 /// Simple classifier that finds the best threshold to separate two classes based on a single feature
 class ThresholdLearner : public Classifier
 {
 public:
+
+    /// EXACT tries every value of the feature as threshold; HISTOGRAM only the edges of its
+    /// quantile bins (see BinnedFeatures), which is faster and within one bin of the exact split
+    enum SplitSearch { EXACT, HISTOGRAM };
+
     ThresholdLearner();
-    ThresholdLearner( unsigned int feature_index);
+    ThresholdLearner( unsigned int feature_index, SplitSearch split_search = EXACT);
+    // already trained learner
+    ThresholdLearner( unsigned int feature_index, double threshold, int label_on_left);
 
-    // inherited from Classifier
+    // inherited from Classifier; defined here so that callers knowing the type can inline them
+    // (see BoostedEnsemble)
     void train(const Dataset & training_dataset, const std::vector<double> &data_weights);
-    double response(const DataInstance & data_instance) const;
-    int    classify(const DataInstance & data_instance) const;
+
+    double response(const DataRow & data_instance) const
+    {
+        double fval = data_instance[feature_index];
+
+        if (!std::isfinite(fval))
+            return fval;
+
+        return (fval - optimal_threshold);
+    }
+
+    int    classify(const DataRow & data_instance) const
+    {
+        double resp = ThresholdLearner::response(data_instance);
+
+        if (!std::isfinite(resp)) return 0;
+
+        // (resp < 0) ? label_on_left : -label_on_left, without a branch: the side is unpredictable
+        return label_on_left * (1 - 2 * (resp >= 0));
+    }
+
+    // Exact training on the sorted index of the dataset, with the labels of its samples gathered
+    // in 'labels' (so that it is done once when many learners are trained on the same dataset)
+    void train(const Dataset & training_dataset, const SortedFeatureIndex & sorted_index,
+               const std::vector<int> & labels, const std::vector<double> &data_weights);
+
+    // caches the sorted feature index (EXACT) or the binned features (HISTOGRAM) in the dataset
+    void prepareTraining(const Dataset & training_dataset, int nthreads) const;
+
+    unsigned int getFeatureIndex() const { return feature_index; }
+    double getThreshold() const { return optimal_threshold; }
+    int getLabelOnLeft() const { return label_on_left; }
 
 private:
 
+    void trainExact(const Dataset & training_dataset, const std::vector<double> &data_weights);
+    void trainHistogram(const Dataset & training_dataset, const std::vector<double> &data_weights);
+
+    // Sets the threshold of minimum weighted error, scanning the samples by increasing feature value:
+    // sorted_values[i] is the value of sample order[i], which has label labels[order[i]] and weight
+    // weights[order[i]]. negative_weight and positive_weight are the total weights of each class.
+    // Samples of zero weight are skipped: they do not bound the thresholds tried.
+    void findBestSplit(const double * sorted_values, const unsigned int * order, size_t nsamples,
+                       const int * labels, const double * weights,
+                       double negative_weight, double positive_weight);
+
     unsigned int feature_index;
+    SplitSearch split_search;
     double optimal_threshold;
     int label_on_left;
 
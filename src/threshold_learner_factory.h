@@ -0,0 +1,64 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THRESHOLD_LEARNER_FACTORY_H_
+#define THRESHOLD_LEARNER_FACTORY_H_
+
+#include <random>
+
+#include "classifier_factory.h"
+#include "threshold_learner.h"
+
+/// Draws decision stumps on features chosen uniformly at random, from a generator seeded with
+/// 'seed'. Recycled stumps are redrawn in place, so boosting trials do not allocate.
+class RandomThresholdLearnerFactory : public ClassifierFactory
+{
+public:
+
+    RandomThresholdLearnerFactory(unsigned int dim, unsigned int seed,
+                                  ThresholdLearner::SplitSearch split_search = ThresholdLearner::EXACT) :
+        dim(dim), split_search(split_search), rng(seed)
+    {
+    }
+
+    Classifier * createRandomInstance() const
+    {
+        return new ThresholdLearner(drawFeature(), split_search);
+    }
+
+    // 'recycled' was created by this factory, so it is a ThresholdLearner
+    Classifier * recycleRandomInstance(Classifier * recycled) const
+    {
+        *static_cast<ThresholdLearner *>(recycled) = ThresholdLearner(drawFeature(), split_search);
+        return recycled;
+    }
+
+private:
+
+    unsigned int drawFeature() const
+    {
+        return std::uniform_int_distribution<unsigned int>(0, dim - 1)(rng);
+    }
+
+    unsigned int dim;
+    ThresholdLearner::SplitSearch split_search;
+    mutable std::mt19937 rng;
+};
+
+#endif  // THRESHOLD_LEARNER_FACTORY_H_
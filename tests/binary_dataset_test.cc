@@ -0,0 +1,169 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/binary_dataset.h"
+#include "src/dataset.h"
+
+// Return the path of a new empty temporary file.
+static std::string TempPath() {
+    char path[] = "/tmp/lakeml_binary_test_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_GE(fd, 0);
+    close(fd);
+    return std::string(path);
+}
+
+static Dataset MakeDataset() {
+    Dataset dataset;
+    for (int i = 0; i < 20; i++) {
+        DataInstance sample;
+        sample.push_back(0.5 * i);
+        sample.push_back(-3.0 * i);
+        dataset.add(sample, (i % 2 == 0) ? 1 : -1);
+    }
+    return dataset;
+}
+
+// Saved samples and labels are read back unchanged, in column-major layout
+TEST(BinaryDatasetTest, SaveAndLoad) {
+    std::string path = TempPath();
+    Dataset original = MakeDataset();
+    SaveBinaryDataset(original, path);
+
+    Dataset loaded = LoadBinaryDataset(path);
+    std::remove(path.c_str());  // the mapping stays valid
+
+    EXPECT_TRUE(loaded.isExternal());
+    EXPECT_EQ(loaded.layout(), Dataset::COLUMN_MAJOR);
+    ASSERT_EQ(loaded.size(), original.size());
+    ASSERT_EQ(loaded.dimension(), original.dimension());
+    EXPECT_TRUE(loaded.column(1).isContiguous());
+    for (size_t i = 0; i < original.size(); i++) {
+        EXPECT_DOUBLE_EQ(loaded[i][0], original[i][0]);
+        EXPECT_DOUBLE_EQ(loaded[i][1], original[i][1]);
+        EXPECT_EQ(loaded.getLabelAt(i), original.getLabelAt(i));
+    }
+}
+
+// Optional weights are stored and returned on request
+TEST(BinaryDatasetTest, Weights) {
+    std::string path = TempPath();
+    Dataset original = MakeDataset();
+    std::vector<double> weights(original.size());
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = 1.0 / (i + 1);
+    SaveBinaryDataset(original, path, &weights);
+
+    std::vector<double> loaded_weights;
+    Dataset loaded = LoadBinaryDataset(path, &loaded_weights);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(loaded_weights, weights);
+}
+
+// Adding to a loaded dataset copies it out of the mapping first
+TEST(BinaryDatasetTest, AddAfterLoad) {
+    std::string path = TempPath();
+    SaveBinaryDataset(MakeDataset(), path);
+    Dataset loaded = LoadBinaryDataset(path);
+    std::remove(path.c_str());
+
+    DataInstance sample(2, 7.0);
+    loaded.add(sample, 1);
+
+    EXPECT_FALSE(loaded.isExternal());
+    ASSERT_EQ(loaded.size(), static_cast<size_t>(21));
+    EXPECT_DOUBLE_EQ(loaded[3][1], -9.0);
+    EXPECT_DOUBLE_EQ(loaded[20][0], 7.0);
+    EXPECT_EQ(loaded.getLabelAt(20), 1);
+}
+
+// A loaded dataset can add one of its own samples
+TEST(BinaryDatasetTest, AddOwnSampleAfterLoad) {
+    std::string path = TempPath();
+    SaveBinaryDataset(MakeDataset(), path);
+    Dataset loaded = LoadBinaryDataset(path);
+    std::remove(path.c_str());
+
+    loaded.add(loaded[5], loaded.getLabelAt(5));
+
+    EXPECT_FALSE(loaded.isExternal());
+    ASSERT_EQ(loaded.size(), static_cast<size_t>(21));
+    EXPECT_DOUBLE_EQ(loaded[20][0], 2.5);
+    EXPECT_DOUBLE_EQ(loaded[20][1], -15.0);
+    EXPECT_EQ(loaded.getLabelAt(20), -1);
+}
+
+// A CSV file converted to binary loads as the same dataset
+TEST(BinaryDatasetTest, ConvertFromCsv) {
+    std::string csv_path = TempPath();
+    {
+        std::ofstream csv(csv_path.c_str());
+        csv << "f1,f2,class\n1.5,2.0,cat\n3.0,-4.0,dog\n";
+    }
+    std::string path = TempPath();
+    ConvertCsvToBinaryDataset(csv_path, path);
+
+    Dataset loaded = LoadBinaryDataset(path);
+    std::remove(csv_path.c_str());
+    std::remove(path.c_str());
+
+    ASSERT_EQ(loaded.size(), static_cast<size_t>(2));
+    EXPECT_DOUBLE_EQ(loaded[1][1], -4.0);
+    EXPECT_EQ(loaded.getLabelAt(0), 0);
+    EXPECT_EQ(loaded.getLabelAt(1), 1);
+}
+
+// Files that are not in the binary format are rejected
+TEST(BinaryDatasetTest, ThrowsOnInvalidFile) {
+    std::string path = TempPath();
+    {
+        std::ofstream f(path.c_str());
+        f << "f1,label\n1.0,0\n";
+    }
+    EXPECT_THROW(LoadBinaryDataset(path), std::runtime_error);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(LoadBinaryDataset("/tmp/this_file_does_not_exist_lakeml.bin"), std::runtime_error);
+}
+
+// A header whose section sizes wrap around 64 bits is rejected
+TEST(BinaryDatasetTest, ThrowsOnOverflowingHeader) {
+    std::string path = TempPath();
+    SaveBinaryDataset(MakeDataset(), path);
+    {
+        // nsamples = 2^62 and dimension = 1, so that every section size is 0 modulo 2^64
+        uint64_t sizes[2] = {uint64_t(1) << 62, 1};
+        std::fstream f(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(16);
+        f.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    }
+    EXPECT_THROW(LoadBinaryDataset(path), std::runtime_error);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,151 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "src/binned_features.h"
+#include "src/dataset.h"
+#include "src/threshold_learner.h"
+
+// Column-major dataset of 'n' samples: a feature with more distinct values than bins, one with
+// exactly 7 values (one bin each) and one with missing values (kept out of the bins)
+static Dataset MakeBinningDataset(int n) {
+    Dataset dataset(Dataset::COLUMN_MAJOR);
+    for (int i = 0; i < n; i++) {
+        double x = std::sin(0.37 * i) * 100.0;
+        DataInstance sample;
+        sample.push_back(x);
+        sample.push_back(static_cast<double>(i % 7));
+        sample.push_back(i % 9 == 0 ? std::numeric_limits<double>::quiet_NaN() : x * x);
+        dataset.add(sample, (x > 20.0) != (i % 10 == 0) ? 1 : -1);
+    }
+    return dataset;
+}
+
+// Every value falls in the bin whose edges surround it
+TEST(BinnedFeaturesTest, BinsSurroundValues) {
+    Dataset dataset = MakeBinningDataset(5000);
+    BinnedFeatures bins(dataset, BinnedFeatures::MAX_BINS, 2);
+
+    ASSERT_EQ(bins.dimension(), dataset.dimension());
+    EXPECT_LE(bins.numBins(0), static_cast<size_t>(BinnedFeatures::MAX_BINS));
+    EXPECT_GT(bins.numBins(0), static_cast<size_t>(200));
+    EXPECT_EQ(bins.numBins(1), static_cast<size_t>(7));
+
+    for (size_t d = 0; d < bins.dimension(); d++) {
+        const uint8_t* codes = bins.binCodes(d);
+        for (size_t i = 0; i < dataset.size(); i++) {
+            double value = dataset[i][d];
+            if (!std::isfinite(value)) {
+                EXPECT_EQ(codes[i], BinnedFeatures::MISSING);
+                continue;
+            }
+            ASSERT_LT(codes[i], bins.numBins(d));
+            EXPECT_GE(value, bins.lowerEdge(d, codes[i]));
+            if (codes[i] + 1u < bins.numBins(d)) {
+                EXPECT_LT(value, bins.lowerEdge(d, codes[i] + 1));
+            }
+        }
+    }
+}
+
+// Bins hold similar numbers of samples
+TEST(BinnedFeaturesTest, QuantileBins) {
+    Dataset dataset = MakeBinningDataset(10000);
+    BinnedFeatures bins(dataset, 16);
+
+    std::vector<int> counts(bins.numBins(0), 0);
+    for (size_t i = 0; i < dataset.size(); i++)
+        counts[bins.binCodes(0)[i]]++;
+
+    ASSERT_EQ(counts.size(), static_cast<size_t>(16));
+    EXPECT_LT(*std::max_element(counts.begin(), counts.end()), 2 * 10000 / 16);
+}
+
+// Binning one feature gives the same bins as binning them all
+TEST(BinnedFeaturesTest, SingleFeature) {
+    Dataset dataset = MakeBinningDataset(2000);
+    BinnedFeatures all(dataset, BinnedFeatures::MAX_BINS, 1);
+
+    for (size_t d = 0; d < dataset.dimension(); d++) {
+        BinnedFeatures single = BinnedFeatures::singleFeature(dataset, d);
+        ASSERT_EQ(single.numBins(d), all.numBins(d));
+        for (size_t b = 0; b < all.numBins(d); b++)
+            EXPECT_EQ(single.lowerEdge(d, b), all.lowerEdge(d, b));
+        EXPECT_TRUE(std::equal(all.binCodes(d), all.binCodes(d) + dataset.size(), single.binCodes(d)));
+        EXPECT_EQ(single.numBins((d + 1) % dataset.dimension()), static_cast<size_t>(0));
+    }
+}
+
+// The cache is dropped when the dataset changes
+TEST(BinnedFeaturesTest, CachedInDataset) {
+    Dataset dataset = MakeBinningDataset(100);
+    const BinnedFeatures& bins = CacheBinnedFeatures(dataset);
+    EXPECT_EQ(dataset.binnedFeatures(), &bins);
+
+    dataset.add(dataset[0], 1);
+    EXPECT_TRUE(dataset.binnedFeatures() == nullptr);
+}
+
+// Weighted error of a learner on the dataset
+static double WeightedError(const ThresholdLearner& learner, const Dataset& dataset,
+                            const std::vector<double>& weights) {
+    double error = 0.0;
+    for (size_t i = 0; i < dataset.size(); i++)
+        if (learner.classify(dataset[i]) != dataset.getLabelAt(i))
+            error += weights[i];
+    return error;
+}
+
+// The histogram threshold is within one bin edge of the exact one
+TEST(BinnedFeaturesTest, HistogramSplitCloseToExact) {
+    Dataset dataset = MakeBinningDataset(3000);
+    const BinnedFeatures& bins = CacheBinnedFeatures(dataset);
+
+    std::vector<double> weights(dataset.size());
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = 1.0 + (i % 3);
+
+    ThresholdLearner exact(0), histogram(0, ThresholdLearner::HISTOGRAM);
+    exact.train(dataset, weights);
+    histogram.train(dataset, weights);
+
+    int exact_bin = bins.binOf(0, exact.getThreshold());
+    int histogram_bin = bins.binOf(0, histogram.getThreshold());
+    EXPECT_EQ(histogram.getThreshold(), bins.lowerEdge(0, histogram_bin));
+    EXPECT_LE(std::abs(exact_bin - histogram_bin), 1);
+    EXPECT_EQ(exact.getLabelOnLeft(), histogram.getLabelOnLeft());
+}
+
+// With fewer distinct values than bins, every threshold is tried
+TEST(BinnedFeaturesTest, HistogramSplitOptimalOnFewValues) {
+    Dataset dataset = MakeBinningDataset(700);
+    std::vector<double> weights(dataset.size());
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = 1.0 + (i % 5);
+
+    ThresholdLearner exact(1), histogram(1, ThresholdLearner::HISTOGRAM);
+    exact.train(dataset, weights);
+    histogram.train(dataset, weights);
+
+    EXPECT_LE(WeightedError(histogram, dataset, weights), WeightedError(exact, dataset, weights));
+}
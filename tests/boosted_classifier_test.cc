@@ -18,20 +18,65 @@
  */
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
 #include <vector>
 #include "src/boosted_classifier.h"
 #include "src/threshold_learner.h"
+#include "src/threshold_learner_factory.h"
 #include "src/classifier_factory.h"
 #include "src/dataset.h"
+#include "src/model_file.h"
 
 // Simple factory for creating threshold learners
 class ThresholdLearnerFactory : public ClassifierFactory {
 public:
-    Classifier* create() const override {
-        return new ThresholdLearner();
+    Classifier* createRandomInstance() const override {
+        return new ThresholdLearner(0);
     }
 };
 
+// Factory drawing threshold learners on pseudo-random features, always in the same sequence
+class CyclingThresholdLearnerFactory : public ClassifierFactory {
+public:
+    explicit CyclingThresholdLearnerFactory(int num_features)
+        : num_features(num_features), draws(0) {}
+
+    Classifier* createRandomInstance() const override {
+        draws++;
+        return new ThresholdLearner((draws * 7) % num_features);
+    }
+
+private:
+    int num_features;
+    mutable int draws;
+};
+
+// Same sequence of learners, reinitializing the recycled ones instead of allocating new ones
+class RecyclingThresholdLearnerFactory : public CyclingThresholdLearnerFactory {
+public:
+    explicit RecyclingThresholdLearnerFactory(int num_features)
+        : CyclingThresholdLearnerFactory(num_features), allocations(0) {}
+
+    Classifier* createRandomInstance() const override {
+        allocations++;
+        return CyclingThresholdLearnerFactory::createRandomInstance();
+    }
+
+    Classifier* recycleRandomInstance(Classifier* recycled) const override {
+        Classifier* drawn = CyclingThresholdLearnerFactory::createRandomInstance();
+        *static_cast<ThresholdLearner*>(recycled) = *static_cast<ThresholdLearner*>(drawn);
+        delete drawn;
+        return recycled;
+    }
+
+    mutable int allocations;
+};
+
 // Test fixture for BoostedClassifier
 class BoostedClassifierTest : public ::testing::Test {
 protected:
@@ -78,6 +123,18 @@ TEST_F(BoostedClassifierTest, TrainAndPredict) {
 }
 
 // Test getNumWeakLearners
+// Labels other than -1, 0 and 1 are rejected
+TEST_F(BoostedClassifierTest, ThrowsOnInvalidLabels) {
+    Dataset training_dataset;
+    for (int i = 0; i < 10; i++) {
+        DataInstance sample(1, static_cast<double>(i));
+        training_dataset.add(sample, (i < 5) ? -1 : 2);
+    }
+
+    std::vector<double> weights(10, 1.0);
+    EXPECT_THROW(classifier->train(training_dataset, weights), std::invalid_argument);
+}
+
 TEST_F(BoostedClassifierTest, GetNumWeakLearners) {
     // Before training, should have 0 weak learners
     EXPECT_EQ(classifier->getNumWeakLearners(), 0);
@@ -162,3 +219,310 @@ TEST_F(BoostedClassifierTest, UniformWeights) {
 
     EXPECT_GT(classifier->getNumWeakLearners(), 0);
 }
+
+// Training the trials in parallel gives the same classifier as training them in turn
+TEST(BoostedClassifierParallelTest, SameResultAsSerial) {
+    Dataset training_dataset;
+    for (int i = 0; i < 500; i++) {
+        DataInstance sample;
+        for (int d = 0; d < 6; d++)
+            sample.push_back(std::sin(0.1 * i * (d + 1)) + 0.01 * ((i * (d + 3)) % 17));
+        training_dataset.add(sample, (sample[1] + sample[4] > 0.2) ? 1 : -1);
+    }
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    CyclingThresholdLearnerFactory serial_factory(6), parallel_factory(6);
+    BoostedClassifier serial(&serial_factory, 20, 9);
+    BoostedClassifier parallel(&parallel_factory, 20, 9);
+    parallel.setNumThreads(4);
+
+    serial.train(training_dataset, weights);
+    parallel.train(training_dataset, weights);
+
+    ASSERT_EQ(parallel.getNumWeakLearners(), serial.getNumWeakLearners());
+    for (size_t i = 0; i < training_dataset.size(); i++)
+        EXPECT_EQ(parallel.response(training_dataset[i]), serial.response(training_dataset[i]));
+}
+
+// Factory drawing a threshold learner on each feature in turn
+class EveryFeatureFactory : public ClassifierFactory {
+public:
+    explicit EveryFeatureFactory(int num_features)
+        : num_features(num_features), draws(0) {}
+
+    Classifier* createRandomInstance() const override {
+        return new ThresholdLearner(draws++ % num_features);
+    }
+
+private:
+    int num_features;
+    mutable int draws;
+};
+
+// Searching all stumps gives the same classifier as one trial per feature
+TEST(BoostedClassifierAllStumpsTest, SameAsOneTrialPerFeature) {
+    Dataset training_dataset;
+    for (int i = 0; i < 400; i++) {
+        DataInstance sample;
+        for (int d = 0; d < 5; d++)
+            sample.push_back(std::cos(0.13 * i * (d + 2)) + 0.02 * ((i * (d + 5)) % 13));
+        training_dataset.add(sample, (sample[0] - sample[3] > 0.1) ? 1 : -1);
+    }
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    EveryFeatureFactory factory(5);
+    BoostedClassifier trials(&factory, 15, 5);
+    BoostedClassifier all_stumps(15);
+    all_stumps.setNumThreads(3);
+
+    trials.train(training_dataset, weights);
+    all_stumps.train(training_dataset, weights);
+
+    ASSERT_EQ(all_stumps.getNumWeakLearners(), 15);
+    for (size_t i = 0; i < training_dataset.size(); i++)
+        EXPECT_EQ(all_stumps.response(training_dataset[i]), trials.response(training_dataset[i]));
+}
+
+// The soft cascade keeps the positives the classifier accepts and rejects negatives early
+TEST(BoostedClassifierCascadeTest, EarlyRejection) {
+    Dataset training_dataset;
+    for (int i = 0; i < 1000; i++) {
+        DataInstance sample;
+        for (int d = 0; d < 4; d++)
+            sample.push_back(std::sin(0.37 * i * (d + 1)) + 0.03 * ((i * (d + 7)) % 19));
+        // few positives, most negatives easy to reject
+        training_dataset.add(sample, (sample[0] > 0.6 && sample[2] > -0.5) ? 1 : -1);
+    }
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    BoostedClassifier classifier(40);
+    classifier.train(training_dataset, weights);
+    std::vector<int> full_classes = static_cast<const Classifier&>(classifier).classify(training_dataset);
+
+    classifier.calibrateSoftCascade(training_dataset);
+    ASSERT_TRUE(classifier.hasSoftCascade());
+
+    long evaluated_on_negatives = 0, negatives = 0;
+    for (size_t i = 0; i < training_dataset.size(); i++) {
+        int nb_evaluated;
+        int label = classifier.classify(training_dataset[i], &nb_evaluated);
+
+        // a sample the cascade does not reject gets its full decision
+        if (nb_evaluated == classifier.getNumWeakLearners() || label == 1) {
+            EXPECT_EQ(label, full_classes[i]);
+        }
+        if (training_dataset.getLabelAt(i) == 1 && full_classes[i] == 1) {
+            EXPECT_EQ(label, 1);
+        }
+
+        if (training_dataset.getLabelAt(i) == -1) {
+            evaluated_on_negatives += nb_evaluated;
+            negatives++;
+        }
+    }
+    EXPECT_LT(evaluated_on_negatives, negatives * classifier.getNumWeakLearners() / 2);
+
+    // training again drops the cascade
+    classifier.train(training_dataset, weights);
+    EXPECT_FALSE(classifier.hasSoftCascade());
+}
+
+static Dataset MakeSubsamplingDataset() {
+    Dataset dataset;
+    for (int i = 0; i < 2000; i++) {
+        DataInstance sample;
+        for (int d = 0; d < 6; d++)
+            sample.push_back(std::sin(0.29 * i * (d + 1)) + 0.02 * ((i * (d + 11)) % 23));
+        dataset.add(sample, (sample[1] + 0.5 * sample[3] > 0.3 || sample[5] < -0.8) ? 1 : -1);
+    }
+    return dataset;
+}
+
+static double TrainingError(const BoostedClassifier& classifier, const Dataset& dataset) {
+    int errors = 0;
+    for (size_t i = 0; i < dataset.size(); i++)
+        errors += classifier.classify(dataset[i]) != dataset.getLabelAt(i);
+    return static_cast<double>(errors) / dataset.size();
+}
+
+// Replays the rounds of a classifier trained with unit weights: the weight of each weak learner
+// is the optimal step on all the samples, whatever subset its search used
+static void ExpectStepsOnAllSamples(const BoostedClassifier& classifier, const Dataset& dataset) {
+    ExponentialLoss loss;
+    std::vector<double> unit_weights(dataset.size(), 1.0), responses(dataset.size(), 0.0);
+    std::vector<double> sample_losses(dataset.size());
+
+    for (int k = 0; k < classifier.getNumWeakLearners(); k++) {
+        loss.value(dataset, unit_weights, responses, sample_losses);
+        std::vector<int> predictions = classifier.getWeakLearner(k)->classify(dataset);
+
+        double step, minimum_loss;
+        loss.optimal_step_along_direction(dataset, sample_losses, predictions, &step, &minimum_loss);
+        EXPECT_NEAR(classifier.getWeakLearnerWeight(k), step, 1e-12 * std::fabs(step));
+
+        for (size_t i = 0; i < dataset.size(); i++)
+            responses[i] += classifier.getWeakLearnerWeight(k) * predictions[i];
+    }
+}
+
+// Weight trimming searches the heaviest samples only, with little loss of accuracy
+TEST(BoostedClassifierSubsamplingTest, WeightTrimming) {
+    Dataset training_dataset = MakeSubsamplingDataset();
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    BoostedClassifier full(30), trimmed(30);
+    trimmed.setWeightTrimming(0.9);
+    full.train(training_dataset, weights);
+    trimmed.train(training_dataset, weights);
+
+    ASSERT_EQ(trimmed.getNumWeakLearners(), 30);
+    EXPECT_LE(TrainingError(trimmed, training_dataset), TrainingError(full, training_dataset) + 0.03);
+    ExpectStepsOnAllSamples(trimmed, training_dataset);
+}
+
+// Gradient-based sampling depends on its seed only, not on the number of threads
+TEST(BoostedClassifierSubsamplingTest, GradientSampling) {
+    Dataset training_dataset = MakeSubsamplingDataset();
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    BoostedClassifier full(30), sampled(30), parallel(30);
+    sampled.setGradientSampling(0.2, 0.1, 7);
+    parallel.setGradientSampling(0.2, 0.1, 7);
+    parallel.setNumThreads(3);
+    full.train(training_dataset, weights);
+    sampled.train(training_dataset, weights);
+    parallel.train(training_dataset, weights);
+
+    ASSERT_EQ(sampled.getNumWeakLearners(), 30);
+    for (size_t i = 0; i < training_dataset.size(); i++)
+        EXPECT_EQ(parallel.response(training_dataset[i]), sampled.response(training_dataset[i]));
+
+    EXPECT_LE(TrainingError(sampled, training_dataset), TrainingError(full, training_dataset) + 0.03);
+    ExpectStepsOnAllSamples(sampled, training_dataset);
+}
+
+// Early stopping keeps the weak learners up to the round with the lowest validation loss
+TEST(BoostedClassifierEarlyStoppingTest, TruncatesAtBestRound) {
+    // noisy labels, so that the validation loss eventually goes up
+    Dataset training_dataset, validation_dataset;
+    for (int i = 0; i < 1200; i++) {
+        DataInstance sample;
+        for (int d = 0; d < 4; d++)
+            sample.push_back(std::sin(0.61 * i * (d + 1)) + 0.05 * ((i * (d + 3)) % 7));
+        int label = (sample[0] + sample[1] > 0.2) ? 1 : -1;
+        if ((i * 37) % 100 < 15)
+            label = -label;
+        (i % 3 == 0 ? validation_dataset : training_dataset).add(sample, label);
+    }
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    BoostedClassifier stopped(200), full(200);
+    stopped.train(training_dataset, weights, validation_dataset, 10);
+    full.train(training_dataset, weights);
+
+    const std::vector<double>& losses = stopped.getValidationLosses();
+    int best_round = std::min_element(losses.begin(), losses.end()) - losses.begin();
+
+    // stopped 10 rounds after the best one, which it was truncated to
+    EXPECT_EQ(static_cast<int>(losses.size()), best_round + 11);
+    ASSERT_EQ(stopped.getNumWeakLearners(), best_round);
+    ASSERT_GT(best_round, 0);
+    ASSERT_LT(best_round, 189);
+
+    // same weak learners as without early stopping, up to the best round
+    for (int m = 0; m < stopped.getNumWeakLearners(); m++)
+        EXPECT_EQ(stopped.getWeakLearnerWeight(m), full.getWeakLearnerWeight(m));
+
+    // the incremental losses are those of the truncated classifier
+    double loss = 0.0;
+    for (size_t i = 0; i < validation_dataset.size(); i++)
+        loss += std::exp(-validation_dataset.getLabelAt(i) * stopped.response(validation_dataset[i]));
+    EXPECT_NEAR(loss, losses[best_round], 1e-9 * loss);
+}
+
+// A training resumed from a checkpoint adds the rounds an uninterrupted training would have
+TEST(BoostedClassifierWarmStartTest, ResumesFromCheckpoint) {
+    Dataset training_dataset = MakeSubsamplingDataset();
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    char path[] = "/tmp/lakeml_checkpoint_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    for (int sampling = 0; sampling < 2; sampling++) {
+        BoostedClassifier uninterrupted(30), interrupted(12), resumed(30);
+        if (sampling) {
+            uninterrupted.setGradientSampling(0.2, 0.1, 7);
+            interrupted.setGradientSampling(0.2, 0.1, 7);
+            resumed.setGradientSampling(0.2, 0.1, 7);
+        }
+
+        // stopped after 12 rounds, the last checkpoint being at round 10
+        interrupted.setCheckpoint(path, 5);
+        interrupted.train(training_dataset, weights);
+        uninterrupted.train(training_dataset, weights);
+
+        LoadModel(path, &resumed);
+        ASSERT_EQ(resumed.getNumWeakLearners(), 10);
+        resumed.train(training_dataset, weights);
+
+        ASSERT_EQ(resumed.getNumWeakLearners(), 30);
+        for (int m = 0; m < 30; m++)
+            EXPECT_EQ(resumed.getWeakLearnerWeight(m), uninterrupted.getWeakLearnerWeight(m));
+        for (size_t i = 0; i < training_dataset.size(); i++)
+            EXPECT_EQ(resumed.response(training_dataset[i]), uninterrupted.response(training_dataset[i]));
+    }
+
+    std::remove(path);
+}
+
+// Candidates recycled by the factory give the same classifier, with one allocation per round
+TEST(BoostedClassifierRecyclingTest, RecycledCandidates) {
+    Dataset training_dataset = MakeSubsamplingDataset();
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    CyclingThresholdLearnerFactory allocating_factory(6);
+    RecyclingThresholdLearnerFactory recycling_factory(6);
+    BoostedClassifier allocating(&allocating_factory, 8, 5), recycling(&recycling_factory, 8, 5);
+    allocating.train(training_dataset, weights);
+    recycling.train(training_dataset, weights);
+
+    // the candidates of the first round only: winning stumps are copied into the arena
+    EXPECT_EQ(recycling_factory.allocations, 5);
+    ASSERT_EQ(recycling.getNumWeakLearners(), 8);
+    for (int m = 0; m < 8; m++)
+        EXPECT_EQ(recycling.getWeakLearnerWeight(m), allocating.getWeakLearnerWeight(m));
+}
+
+// The same random stump factory, deleting recycled candidates and allocating new ones
+class AllocatingRandomFactory : public RandomThresholdLearnerFactory {
+public:
+    AllocatingRandomFactory(unsigned int dim, unsigned int seed) : RandomThresholdLearnerFactory(dim, seed) {}
+
+    Classifier* recycleRandomInstance(Classifier* recycled) const override {
+        return ClassifierFactory::recycleRandomInstance(recycled);
+    }
+};
+
+// Stumps redrawn in place follow the sequence of newly allocated ones
+TEST(BoostedClassifierRecyclingTest, RandomThresholdLearnerFactory) {
+    Dataset training_dataset = MakeSubsamplingDataset();
+    std::vector<double> weights(training_dataset.size(), 1.0);
+
+    RandomThresholdLearnerFactory recycling_factory(training_dataset.dimension(), 3);
+    AllocatingRandomFactory allocating_factory(training_dataset.dimension(), 3);
+    BoostedClassifier recycling(&recycling_factory, 10, 4), allocating(&allocating_factory, 10, 4);
+    recycling.train(training_dataset, weights);
+    allocating.train(training_dataset, weights);
+
+    ASSERT_EQ(recycling.getNumWeakLearners(), 10);
+    for (int m = 0; m < 10; m++) {
+        const ThresholdLearner* stump = dynamic_cast<const ThresholdLearner*>(recycling.getWeakLearner(m));
+        const ThresholdLearner* expected = dynamic_cast<const ThresholdLearner*>(allocating.getWeakLearner(m));
+        ASSERT_TRUE(stump != nullptr && expected != nullptr);
+        EXPECT_EQ(stump->getFeatureIndex(), expected->getFeatureIndex());
+        EXPECT_EQ(stump->getThreshold(), expected->getThreshold());
+        EXPECT_EQ(recycling.getWeakLearnerWeight(m), allocating.getWeakLearnerWeight(m));
+    }
+}
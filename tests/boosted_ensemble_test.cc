@@ -0,0 +1,108 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+#include "src/boosted_classifier.h"
+#include "src/boosted_ensemble.h"
+#include "src/classifier_factory.h"
+#include "src/dataset.h"
+#include "src/gaussian_learner.h"
+#include "src/threshold_learner.h"
+#include "tests/test_datasets.h"
+
+// Gaussian learners on features 0 to 3 in turn
+class GaussianLearnerFactory : public ClassifierFactory {
+public:
+    GaussianLearnerFactory() : draws(0) {}
+
+    Classifier* createRandomInstance() const override {
+        return new GaussianLearner(draws++ % 4);
+    }
+
+private:
+    mutable int draws;
+};
+
+// Stumps stored by value respond and classify exactly like the boosted classifier
+TEST(BoostedEnsembleTest, SameResultsAsBoostedClassifier) {
+    Dataset dataset = MakeSineDataset(500);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier boosted(30);
+    boosted.train(dataset, weights);
+    BoostedEnsemble<ThresholdLearner> ensemble(boosted);
+
+    ASSERT_EQ(ensemble.size(), static_cast<size_t>(30));
+    EXPECT_EQ(ensemble.getWeakLearner(3).getFeatureIndex(),
+              static_cast<const ThresholdLearner*>(boosted.getWeakLearner(3))->getFeatureIndex());
+
+    std::vector<double> responses(dataset.size());
+    ensemble.response(dataset, 0, dataset.size(), responses.data());
+    for (size_t i = 0; i < dataset.size(); i++) {
+        EXPECT_EQ(ensemble.response(dataset[i]), boosted.response(dataset[i]));
+        EXPECT_EQ(responses[i], boosted.response(dataset[i]));
+        EXPECT_EQ(ensemble.classify(dataset[i]), boosted.classify(dataset[i]));
+    }
+}
+
+// Any weak learner type can be stored by value
+TEST(BoostedEnsembleTest, GaussianLearners) {
+    Dataset dataset = MakeSineDataset(300);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    GaussianLearnerFactory factory;
+    BoostedClassifier boosted(&factory, 12, 4);
+    boosted.train(dataset, weights);
+    BoostedEnsemble<GaussianLearner> ensemble(boosted);
+
+    ASSERT_EQ(ensemble.size(), static_cast<size_t>(12));
+    for (size_t i = 0; i < dataset.size(); i++)
+        EXPECT_EQ(ensemble.response(dataset[i]), boosted.response(dataset[i]));
+}
+
+// The soft cascade rejects the same samples after the same number of weak learners
+TEST(BoostedEnsembleTest, SoftCascade) {
+    Dataset dataset = MakeSineDataset(500);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier boosted(30);
+    boosted.train(dataset, weights);
+    boosted.calibrateSoftCascade(dataset);
+    BoostedEnsemble<ThresholdLearner> ensemble(boosted);
+
+    for (size_t i = 0; i < dataset.size(); i++) {
+        int boosted_evaluated, ensemble_evaluated;
+        EXPECT_EQ(ensemble.classify(dataset[i], &ensemble_evaluated), boosted.classify(dataset[i], &boosted_evaluated));
+        EXPECT_EQ(ensemble_evaluated, boosted_evaluated);
+    }
+}
+
+// Weak learners of another type are rejected
+TEST(BoostedEnsembleTest, RejectsOtherTypes) {
+    Dataset dataset = MakeSineDataset(100);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    GaussianLearnerFactory factory;
+    BoostedClassifier boosted(&factory, 3, 2);
+    boosted.train(dataset, weights);
+
+    EXPECT_THROW(BoostedEnsemble<ThresholdLearner> ensemble(boosted), std::invalid_argument);
+}
@@ -0,0 +1,98 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "src/classifier_arena.h"
+#include "src/threshold_learner.h"
+
+// Classifier counting its live instances, with a payload larger than a threshold learner
+class CountedClassifier : public Classifier {
+public:
+    explicit CountedClassifier(int* live) : live(live) { (*live)++; }
+    ~CountedClassifier() override { (*live)--; }
+
+    void train(const Dataset&, const std::vector<double>&) override {}
+    double response(const DataRow&) const override { return payload[0]; }
+    int classify(const DataRow&) const override { return 1; }
+
+private:
+    int* live;
+    double payload[64] = {0.5};
+};
+
+// Classifiers created in the arena are packed in blocks and destroyed with it
+TEST(ClassifierArenaTest, CreateAndDestroy) {
+    int live = 0;
+    {
+        ClassifierArena arena;
+        for (int i = 0; i < 1000; i++)
+            arena.create<CountedClassifier>(&live);
+        ThresholdLearner* stump = arena.create<ThresholdLearner>(2, 0.5, -1);
+
+        ASSERT_EQ(arena.size(), static_cast<size_t>(1001));
+        EXPECT_EQ(live, 1000);
+        EXPECT_EQ(arena[1000], stump);
+        EXPECT_EQ(stump->getFeatureIndex(), 2u);
+
+        // consecutive classifiers are next to each other in memory
+        const char* first = reinterpret_cast<const char*>(arena[0]);
+        const char* second = reinterpret_cast<const char*>(arena[1]);
+        EXPECT_EQ(second - first, static_cast<long>(sizeof(CountedClassifier)));
+    }
+    EXPECT_EQ(live, 0);
+}
+
+// Adopted classifiers are deleted by the arena, in sequence with the created ones
+TEST(ClassifierArenaTest, Adopt) {
+    int live = 0;
+    {
+        ClassifierArena arena;
+        arena.create<CountedClassifier>(&live);
+        Classifier* adopted = arena.adopt(new CountedClassifier(&live));
+        arena.create<CountedClassifier>(&live);
+
+        ASSERT_EQ(arena.size(), static_cast<size_t>(3));
+        EXPECT_EQ(arena[1], adopted);
+        EXPECT_EQ(live, 3);
+    }
+    EXPECT_EQ(live, 0);
+}
+
+// Truncating destroys the last classifiers and their memory is reused
+TEST(ClassifierArenaTest, Truncate) {
+    int live = 0;
+    ClassifierArena arena;
+    for (int i = 0; i < 300; i++)
+        arena.create<CountedClassifier>(&live);
+    Classifier* tenth = arena[10];
+
+    arena.truncate(10);
+    EXPECT_EQ(arena.size(), static_cast<size_t>(10));
+    EXPECT_EQ(live, 10);
+
+    EXPECT_EQ(arena.create<CountedClassifier>(&live), tenth);
+    for (int i = 0; i < 300; i++)
+        arena.adopt(new CountedClassifier(&live));
+    EXPECT_EQ(live, 311);
+
+    arena.clear();
+    EXPECT_TRUE(arena.empty());
+    EXPECT_EQ(live, 0);
+}
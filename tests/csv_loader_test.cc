@@ -19,6 +19,7 @@
 
 #include <cstdio>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 
@@ -120,3 +121,146 @@ TEST(CsvLoaderTest, IgnoresEmptyLines) {
 
     EXPECT_EQ(ds.size(), static_cast<size_t>(2));
 }
+
+// Expect two datasets to hold the same samples and labels.
+static void ExpectSameDataset(const Dataset &expected, const Dataset &actual) {
+    ASSERT_EQ(actual.size(), expected.size());
+    ASSERT_EQ(actual.dimension(), expected.dimension());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        for (size_t d = 0; d < expected.dimension(); ++d) {
+            ASSERT_EQ(actual[i][d], expected[i][d]) << "sample " << i << " feature " << d;
+        }
+        ASSERT_EQ(actual.getLabelAt(i), expected.getLabelAt(i)) << "sample " << i;
+    }
+}
+
+// The parallel loader gives the same dataset as LoadCsvDataset on small files.
+TEST(CsvLoaderTest, ParallelMatchesSequential) {
+    std::string path = WriteTempCsv(
+        "f1,f2,class\n"
+        "1.0,-2.5e3,cat\n"
+        "\n"
+        "0.1,7,dog\n"
+        " 3.25,.5,12\n"
+        "1e-5,2E+2,cat\n"
+        "0x10,inf,-3\n"
+        "123456789012345678901,0.30000000000000004,dog\n");
+
+    Dataset expected = LoadCsvDataset(path);
+    Dataset actual = LoadCsvDatasetParallel(path, 4);
+    std::remove(path.c_str());
+
+    ExpectSameDataset(expected, actual);
+}
+
+// Large files are split into chunks parsed by several threads; string labels
+// still get the numbers they would get when the file is read sequentially.
+TEST(CsvLoaderTest, ParallelChunksKeepLabelOrder) {
+    std::ostringstream content;
+    content << "a,b,c,label\n";
+    const char *names[] = {"zebra", "yak", "xerus", "wolf", "vole"};
+    for (int i = 0; i < 200000; ++i) {
+        content << i * 0.25 << "," << -i << "," << (i % 97) / 7.0 << ",";
+        // a new label name shows up in each fifth of the file
+        int name = (i * 5 / 200000 + i % 2) % 5;
+        if (i % 3 == 0) {
+            content << i % 4 << "\n";
+        } else {
+            content << names[name] << "\n";
+        }
+    }
+    std::string path = WriteTempCsv(content.str());
+
+    Dataset expected = LoadCsvDataset(path);
+    Dataset actual = LoadCsvDatasetParallel(path, 4);
+    std::remove(path.c_str());
+
+    ExpectSameDataset(expected, actual);
+}
+
+// Malformed values make the parallel loader throw like std::stod does.
+TEST(CsvLoaderTest, ParallelThrowsOnMalformedValue) {
+    std::string path = WriteTempCsv(
+        "f1,label\n"
+        "1.0,0\n"
+        "abc,1\n");
+
+    EXPECT_THROW(LoadCsvDatasetParallel(path, 2), std::invalid_argument);
+    std::remove(path.c_str());
+}
+
+// Rows with a different number of columns are rejected by both loaders.
+TEST(CsvLoaderTest, ThrowsOnInconsistentColumns) {
+    std::string path = WriteTempCsv(
+        "f1,f2,label\n"
+        "1.0,2.0,0\n"
+        "3.0,1\n");
+
+    EXPECT_THROW(LoadCsvDataset(path), std::runtime_error);
+    EXPECT_THROW(LoadCsvDatasetParallel(path, 2), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+// Missing file should throw a std::runtime_error.
+TEST(CsvLoaderTest, ParallelThrowsOnMissingFile) {
+    EXPECT_THROW(LoadCsvDatasetParallel("/tmp/this_file_does_not_exist_lakeml.csv"),
+                 std::runtime_error);
+}
+
+// Batches cover the whole file in order, with the labels LoadCsvDataset gives.
+TEST(CsvLoaderTest, BatchReaderMatchesLoader) {
+    std::ostringstream content;
+    content << "f1,f2,class\n";
+    const char *names[] = {"cat", "dog", "bird"};
+    for (int i = 0; i < 25; ++i) {
+        content << i << "," << -0.5 * i << "," << names[(i * 7) % 3] << "\n";
+        if (i == 10) content << "\n";
+    }
+    std::string path = WriteTempCsv(content.str());
+
+    Dataset expected = LoadCsvDataset(path);
+    CsvBatchReader reader(path, 4);
+    Dataset batch;
+    std::vector<size_t> batch_sizes;
+    size_t row = 0;
+    while (reader.next(&batch)) {
+        batch_sizes.push_back(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i, ++row) {
+            ASSERT_LT(row, expected.size());
+            EXPECT_EQ(batch[i][0], expected[row][0]);
+            EXPECT_EQ(batch[i][1], expected[row][1]);
+            EXPECT_EQ(batch.getLabelAt(i), expected.getLabelAt(row));
+        }
+    }
+    std::remove(path.c_str());
+
+    EXPECT_EQ(row, expected.size());
+    EXPECT_EQ(reader.rowsRead(), expected.size());
+    ASSERT_EQ(batch_sizes.size(), static_cast<size_t>(7));
+    EXPECT_EQ(batch_sizes[0], static_cast<size_t>(4));
+    EXPECT_EQ(batch_sizes[6], static_cast<size_t>(1));
+    EXPECT_EQ(batch.size(), static_cast<size_t>(0));
+}
+
+// The memory limit caps the number of rows per batch.
+TEST(CsvLoaderTest, BatchReaderMemoryLimit) {
+    std::ostringstream content;
+    content << "a,b,c,label\n";
+    for (int i = 0; i < 100; ++i) {
+        content << i << "," << i << "," << i << ",1\n";
+    }
+    std::string path = WriteTempCsv(content.str());
+
+    // one row takes 3 doubles and an int: 28 bytes
+    CsvBatchReader reader(path, 50, 28 * 10);
+    Dataset batch;
+    int nbatches = 0;
+    while (reader.next(&batch)) {
+        EXPECT_LE(batch.size(), static_cast<size_t>(10));
+        ++nbatches;
+    }
+    std::remove(path.c_str());
+
+    EXPECT_EQ(reader.batchSize(), static_cast<size_t>(10));
+    EXPECT_EQ(nbatches, 10);
+}
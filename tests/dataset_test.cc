@@ -0,0 +1,173 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include "src/dataset.h"
+#include "src/threshold_learner.h"
+
+// Build a dataset with 'n' samples of 3 features: (i, 10 * i, -i)
+static Dataset MakeDataset(Dataset::Layout layout, int n) {
+    Dataset dataset(layout);
+    for (int i = 0; i < n; i++) {
+        DataInstance sample;
+        sample.push_back(static_cast<double>(i));
+        sample.push_back(static_cast<double>(10 * i));
+        sample.push_back(static_cast<double>(-i));
+        dataset.add(sample, (i % 3 == 0) ? 1 : -1);
+    }
+    return dataset;
+}
+
+// Row and column accessors return the same values in both layouts
+TEST(DatasetTest, RowAndColumnAccess) {
+    Dataset layouts[] = {MakeDataset(Dataset::ROW_MAJOR, 40),
+                         MakeDataset(Dataset::COLUMN_MAJOR, 40)};
+
+    for (int l = 0; l < 2; l++) {
+        const Dataset& dataset = layouts[l];
+        ASSERT_EQ(dataset.size(), static_cast<size_t>(40));
+        ASSERT_EQ(dataset.dimension(), static_cast<size_t>(3));
+
+        for (size_t i = 0; i < dataset.size(); i++) {
+            EXPECT_EQ(dataset[i].size(), static_cast<size_t>(3));
+            EXPECT_DOUBLE_EQ(dataset[i][1], 10.0 * i);
+            EXPECT_DOUBLE_EQ(dataset.column(2)[i], -1.0 * i);
+            EXPECT_EQ(dataset.getLabelAt(i), (i % 3 == 0) ? 1 : -1);
+        }
+    }
+}
+
+// Column-major columns are contiguous arrays, also after the storage grows
+TEST(DatasetTest, ColumnMajorColumnsAreContiguous) {
+    Dataset dataset = MakeDataset(Dataset::COLUMN_MAJOR, 100);
+
+    FeatureColumn column = dataset.column(1);
+    ASSERT_TRUE(column.isContiguous());
+    for (size_t i = 0; i < column.size(); i++)
+        EXPECT_DOUBLE_EQ(column.data()[i], 10.0 * i);
+}
+
+// Converting between layouts keeps samples and labels
+TEST(DatasetTest, ConvertLayout) {
+    Dataset rows = MakeDataset(Dataset::ROW_MAJOR, 25);
+    Dataset columns(rows, Dataset::COLUMN_MAJOR);
+
+    EXPECT_EQ(columns.layout(), Dataset::COLUMN_MAJOR);
+    ASSERT_EQ(columns.size(), rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        for (size_t d = 0; d < rows.dimension(); d++)
+            EXPECT_DOUBLE_EQ(columns[i][d], rows[i][d]);
+        EXPECT_EQ(columns.getLabelAt(i), rows.getLabelAt(i));
+    }
+}
+
+// A threshold learner finds the same split whatever the storage layout
+TEST(DatasetTest, ThresholdLearnerIndependentOfLayout) {
+    Dataset rows = MakeDataset(Dataset::ROW_MAJOR, 30);
+    Dataset columns(rows, Dataset::COLUMN_MAJOR);
+    std::vector<double> weights(rows.size(), 1.0);
+
+    ThresholdLearner on_rows(1), on_columns(1);
+    on_rows.train(rows, weights);
+    on_columns.train(columns, weights);
+
+    for (size_t i = 0; i < rows.size(); i++)
+        EXPECT_EQ(on_rows.classify(rows[i]), on_columns.classify(columns[i]));
+}
+
+// Adding a row of the dataset to itself is safe even when the buffer grows
+TEST(DatasetTest, AddOwnRow) {
+    Dataset layouts[] = {MakeDataset(Dataset::ROW_MAJOR, 16),
+                         MakeDataset(Dataset::COLUMN_MAJOR, 16)};
+
+    for (int l = 0; l < 2; l++) {
+        Dataset& dataset = layouts[l];
+        for (int i = 0; i < 64; i++)
+            dataset.add(dataset[i], dataset.getLabelAt(i));
+
+        ASSERT_EQ(dataset.size(), static_cast<size_t>(80));
+        for (size_t i = 16; i < dataset.size(); i++)
+            EXPECT_DOUBLE_EQ(dataset[i][1], dataset[i - 16][1]);
+    }
+}
+
+// Classifiers read samples straight from the dataset buffer through row views
+TEST(DatasetTest, ClassifyRowViews) {
+    Dataset dataset = MakeDataset(Dataset::ROW_MAJOR, 30);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    ThresholdLearner learner(0);
+    learner.train(dataset, weights);
+
+    const Classifier& classifier = learner;
+    std::vector<double> responses = classifier.response(dataset);
+    ASSERT_EQ(responses.size(), dataset.size());
+    for (size_t i = 0; i < dataset.size(); i++) {
+        DataInstance copy;
+        for (size_t d = 0; d < dataset.dimension(); d++)
+            copy.push_back(dataset[i][d]);
+        EXPECT_EQ(responses[i], learner.response(copy));
+    }
+}
+
+// Reserving room in a dataset over external storage copies the samples first
+TEST(DatasetTest, ReserveExternal) {
+    Dataset rows = MakeDataset(Dataset::ROW_MAJOR, 30);
+    std::shared_ptr<std::vector<double> > values(new std::vector<double>());
+    std::vector<int> labels;
+    for (size_t d = 0; d < rows.dimension(); d++)
+        for (size_t i = 0; i < rows.size(); i++)
+            values->push_back(rows[i][d]);
+    for (size_t i = 0; i < rows.size(); i++)
+        labels.push_back(rows.getLabelAt(i));
+
+    Dataset dataset(Dataset::COLUMN_MAJOR, rows.size(), rows.dimension(), values->data(), labels.data(), values);
+    dataset.reserve(100);
+
+    EXPECT_FALSE(dataset.isExternal());
+    ASSERT_EQ(dataset.size(), rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        for (size_t d = 0; d < rows.dimension(); d++)
+            EXPECT_DOUBLE_EQ(dataset[i][d], rows[i][d]);
+        EXPECT_EQ(dataset.getLabelAt(i), rows.getLabelAt(i));
+    }
+
+    dataset.add(rows[0], 1);
+    EXPECT_DOUBLE_EQ(dataset[30][1], 0.0);
+}
+
+// A cleared dataset can be refilled, in both layouts
+TEST(DatasetTest, ClearAndRefill) {
+    Dataset layouts[] = {MakeDataset(Dataset::ROW_MAJOR, 40),
+                         MakeDataset(Dataset::COLUMN_MAJOR, 40)};
+
+    for (int l = 0; l < 2; l++) {
+        Dataset& dataset = layouts[l];
+        dataset.clear();
+        EXPECT_EQ(dataset.size(), static_cast<size_t>(0));
+
+        DataInstance sample(3, 2.0);
+        dataset.add(sample, 1);
+        ASSERT_EQ(dataset.size(), static_cast<size_t>(1));
+        EXPECT_DOUBLE_EQ(dataset[0][2], 2.0);
+        EXPECT_EQ(dataset.getLabelAt(0), 1);
+    }
+}
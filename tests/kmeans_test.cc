@@ -0,0 +1,300 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "src/cpu_features.h"
+#include "src/csv_loader.h"
+#include "src/dataset.h"
+#include "src/kmeans.h"
+#include "src/minibatch_kmeans.h"
+
+// 'n' samples of 2 features around blob centers (0, 0), (10, 0) and (0, 10) in turn,
+// labelled with their blob
+static std::vector<double> MakeBlobValues(int n) {
+    std::vector<double> values;
+    for (int i = 0; i < n; i++) {
+        int blob = i % 3;
+        values.push_back((blob == 1 ? 10.0 : 0.0) + std::sin(1.3 * i));
+        values.push_back((blob == 2 ? 10.0 : 0.0) + std::cos(0.7 * i));
+    }
+    return values;
+}
+
+static Dataset MakeBlobs(int n) {
+    std::vector<double> values = MakeBlobValues(n);
+    Dataset dataset;
+    for (int i = 0; i < n; i++)
+        dataset.add(DataRow(&values[2 * i], 2, 1), i % 3);
+    return dataset;
+}
+
+// Each blob of 'dataset' is one cluster of 'kmeans'
+template <class KmeansType>
+static void ExpectSeparatesBlobs(const KmeansType& kmeans, const Dataset& dataset) {
+    std::vector<int> blob_cluster(3, -1);
+    for (size_t i = 0; i < dataset.size(); i++) {
+        int cluster = kmeans.getClosestClusterLabel(dataset[i]);
+        int& expected = blob_cluster[dataset.getLabelAt(i)];
+        if (expected < 0)
+            expected = cluster;
+        EXPECT_EQ(cluster, expected);
+    }
+    EXPECT_NE(blob_cluster[0], blob_cluster[1]);
+    EXPECT_NE(blob_cluster[0], blob_cluster[2]);
+    EXPECT_NE(blob_cluster[1], blob_cluster[2]);
+}
+
+// Every blob is one cluster
+TEST(KmeansTest, SeparatesBlobs) {
+    Dataset dataset = MakeBlobs(300);
+
+    std::srand(3);
+    Kmeans kmeans(dataset, 3);
+    kmeans.run(100, 0.001f);
+
+    ExpectSeparatesBlobs(kmeans, dataset);
+}
+
+// The samples are read in place: a dataset over external storage is not copied
+TEST(KmeansTest, BorrowsDataset) {
+    std::shared_ptr<std::vector<double> > values(new std::vector<double>(MakeBlobValues(300)));
+    std::vector<int> labels(300, 1);
+    Dataset dataset(Dataset::ROW_MAJOR, 300, 2, values->data(), labels.data(), values);
+    long owners = values.use_count();
+
+    Kmeans kmeans(dataset, 3);
+    kmeans.run(100, 0.001f);
+
+    EXPECT_EQ(values.use_count(), owners);
+    EXPECT_TRUE(dataset.isExternal());
+}
+
+// A subset of the samples is clustered like a dataset holding only those samples
+TEST(KmeansTest, SampleIndices) {
+    Dataset dataset = MakeBlobs(300);
+    std::vector<unsigned int> indices;
+    Dataset subset;
+    for (unsigned int i = 0; i < dataset.size(); i++) {
+        if (dataset.getLabelAt(i) != 2 && i % 5 != 0) {
+            indices.push_back(i);
+            subset.add(dataset[i], dataset.getLabelAt(i));
+        }
+    }
+
+    std::srand(5);
+    Kmeans on_indices(dataset, indices, 2);
+    int iterations_on_indices = on_indices.run(100, 0.001f);
+    std::srand(5);
+    Kmeans on_subset(subset, 2);
+    int iterations_on_subset = on_subset.run(100, 0.001f);
+
+    EXPECT_EQ(iterations_on_indices, iterations_on_subset);
+    for (size_t i = 0; i < dataset.size(); i++)
+        EXPECT_EQ(on_indices.getClosestClusterLabel(dataset[i]), on_subset.getClosestClusterLabel(dataset[i]));
+
+    // the two blobs sampled are split apart
+    EXPECT_NE(on_indices.getClosestClusterLabel(dataset[0]), on_indices.getClosestClusterLabel(dataset[1]));
+}
+
+// k-means++ and k-means|| find the blobs and depend on their seed only, not on rand()
+TEST(KmeansTest, SeededInitialization) {
+    Dataset dataset = MakeBlobs(600);
+    Kmeans::Seeding seedings[] = {Kmeans::KMEANS_PLUS_PLUS, Kmeans::KMEANS_PARALLEL};
+
+    for (int m = 0; m < 2; m++) {
+        std::srand(1);
+        Kmeans first(dataset, 3);
+        first.setSeeding(seedings[m], 42);
+        int first_iterations = first.run(100, 0.001f);
+
+        std::srand(2);
+        Kmeans second(dataset, 3);
+        second.setSeeding(seedings[m], 42);
+        int second_iterations = second.run(100, 0.001f);
+
+        EXPECT_EQ(first_iterations, second_iterations);
+        std::vector<int> blob_cluster(3, -1);
+        for (size_t i = 0; i < dataset.size(); i++) {
+            int cluster = first.getClosestClusterLabel(dataset[i]);
+            EXPECT_EQ(second.getClosestClusterLabel(dataset[i]), cluster);
+
+            int& expected = blob_cluster[dataset.getLabelAt(i)];
+            if (expected < 0)
+                expected = cluster;
+            EXPECT_EQ(cluster, expected);
+        }
+        EXPECT_NE(blob_cluster[0], blob_cluster[1]);
+        EXPECT_NE(blob_cluster[0], blob_cluster[2]);
+        EXPECT_NE(blob_cluster[1], blob_cluster[2]);
+    }
+}
+
+// Seeding copes with fewer distinct samples than clusters
+TEST(KmeansTest, SeedingDuplicateSamples) {
+    Dataset dataset;
+    for (int i = 0; i < 50; i++)
+        dataset.add(DataInstance(2, (i % 2) * 5.0), 0);
+
+    Kmeans::Seeding seedings[] = {Kmeans::KMEANS_PLUS_PLUS, Kmeans::KMEANS_PARALLEL};
+    for (int m = 0; m < 2; m++) {
+        Kmeans kmeans(dataset, 4);
+        kmeans.setSeeding(seedings[m], 7);
+        kmeans.run(100, 0.001f);
+
+        EXPECT_NE(kmeans.getClosestClusterLabel(dataset[0]), kmeans.getClosestClusterLabel(dataset[1]));
+    }
+}
+
+// Runs k-means with each assignment algorithm, expecting the same iterations and clusters as Lloyd
+static void ExpectSameAsLloyd(const Dataset& dataset, int nclusters) {
+    Kmeans lloyd(dataset, nclusters);
+    lloyd.setSeeding(Kmeans::KMEANS_PLUS_PLUS, 11);
+    int lloyd_iterations = lloyd.run(100, 0.0f);
+
+    Kmeans::Algorithm algorithms[] = {Kmeans::HAMERLY, Kmeans::ELKAN};
+    for (int a = 0; a < 2; a++) {
+        Kmeans accelerated(dataset, nclusters);
+        accelerated.setSeeding(Kmeans::KMEANS_PLUS_PLUS, 11);
+        accelerated.setAlgorithm(algorithms[a]);
+
+        EXPECT_EQ(accelerated.run(100, 0.0f), lloyd_iterations);
+        for (size_t i = 0; i < dataset.size(); i++)
+            EXPECT_EQ(accelerated.getClosestClusterLabel(dataset[i]), lloyd.getClosestClusterLabel(dataset[i]));
+    }
+}
+
+// Hamerly and Elkan skip distances but assign the samples exactly as Lloyd
+TEST(KmeansTest, BoundedAssignmentsSameAsLloyd) {
+    // more clusters than blobs, so that centers keep moving for a while
+    ExpectSameAsLloyd(MakeBlobs(900), 12);
+
+    // points of an integer grid, at equal distances of several centers
+    Dataset grid;
+    for (int i = 0; i < 400; i++) {
+        DataInstance sample;
+        sample.push_back(i % 20);
+        sample.push_back((i / 20) % 20);
+        grid.add(sample, 0);
+    }
+    ExpectSameAsLloyd(grid, 9);
+}
+
+// Threads and vector instructions change neither the seeding, the assignments nor the centers,
+// for row- and column-major datasets of dimensions that are not a multiple of the vector width
+TEST(KmeansTest, SameWithThreadsAndSimdLevels) {
+    Dataset::Layout layouts[] = {Dataset::ROW_MAJOR, Dataset::COLUMN_MAJOR};
+    Kmeans::Algorithm algorithms[] = {Kmeans::LLOYD, Kmeans::HAMERLY, Kmeans::ELKAN};
+    SimdLevel levels[] = {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512};
+    int threads[] = {1, 3};
+
+    for (int l = 0; l < 2; l++) {
+        Dataset dataset(layouts[l]);
+        for (int i = 0; i < 5000; i++) {
+            DataInstance x(19);
+            for (size_t d = 0; d < x.size(); d++)
+                x[d] = 4.0 * ((i * (d + 3)) % 5) + std::sin(0.37 * i + d);
+            dataset.add(x, 0);
+        }
+
+        for (int seeding = Kmeans::KMEANS_PLUS_PLUS; seeding <= Kmeans::KMEANS_PARALLEL; seeding++) {
+            std::vector<int> expected;
+            int expected_iterations = 0;
+            for (int a = 0; a < 3; a++)
+                for (int s = 0; s < 3; s++)
+                    for (int t = 0; t < 2; t++) {
+                        Kmeans kmeans(dataset, 8);
+                        kmeans.setSeeding(static_cast<Kmeans::Seeding>(seeding), 11);
+                        kmeans.setAlgorithm(algorithms[a]);
+                        kmeans.setSimdLevel(levels[s]);
+                        kmeans.setNumThreads(threads[t]);
+                        int iterations = kmeans.run(100, 0.0f);
+
+                        std::vector<int> labels;
+                        for (size_t i = 0; i < dataset.size(); i++)
+                            labels.push_back(kmeans.getClosestClusterLabel(dataset[i]));
+
+                        if (expected.empty()) {
+                            expected = labels;
+                            expected_iterations = iterations;
+                        }
+                        EXPECT_EQ(labels, expected);
+                        EXPECT_EQ(iterations, expected_iterations);
+                    }
+        }
+    }
+}
+
+// Mini-batches drawn from the dataset find the blobs, whose centers are the running means
+TEST(KmeansTest, MiniBatch) {
+    Dataset dataset = MakeBlobs(3000);
+
+    MiniBatchKmeans kmeans(3, 5);
+    kmeans.run(dataset, 30, 200);
+    ExpectSeparatesBlobs(kmeans, dataset);
+
+    size_t total = 0;
+    for (int c = 0; c < 3; c++) {
+        EXPECT_GT(kmeans.getClusterCounts()[c], static_cast<size_t>(1000));
+        total += kmeans.getClusterCounts()[c];
+
+        // blob centers are (0, 0), (10, 0) and (0, 10)
+        const std::vector<double>& center = kmeans.getClusterCenters()[c];
+        EXPECT_NEAR(center[0], center[0] > 5.0 ? 10.0 : 0.0, 0.5);
+        EXPECT_NEAR(center[1], center[1] > 5.0 ? 10.0 : 0.0, 0.5);
+    }
+    EXPECT_EQ(total, static_cast<size_t>(30 * 200));
+
+    // the same seed draws the same batches
+    MiniBatchKmeans again(3, 5);
+    again.run(dataset, 30, 200);
+    EXPECT_EQ(again.getClusterCenters(), kmeans.getClusterCenters());
+}
+
+// Batches streamed from a CSV file, which are not kept
+TEST(KmeansTest, MiniBatchStreaming) {
+    Dataset dataset = MakeBlobs(900);
+
+    char path[] = "/tmp/lakeml_kmeans_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    {
+        std::ofstream f(path);
+        f << "x,y,blob\n";
+        for (size_t i = 0; i < dataset.size(); i++)
+            f << dataset[i][0] << "," << dataset[i][1] << "," << dataset.getLabelAt(i) << "\n";
+    }
+
+    MiniBatchKmeans kmeans(3, 7);
+    CsvBatchReader reader(path, 50);
+    Dataset batch;
+    while (reader.next(&batch))
+        kmeans.update(batch);
+    std::remove(path);
+
+    ExpectSeparatesBlobs(kmeans, dataset);
+}
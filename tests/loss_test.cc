@@ -18,6 +18,10 @@
  */
 
 #include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 #include <vector>
 #include "src/exponential_loss.h"
 #include "src/dataset.h"
@@ -109,3 +113,189 @@ TEST_F(ExponentialLossTest, ZeroWeights) {
     // Loss with zero weight should be zero
     EXPECT_EQ(out_loss[0], 0.0);
 }
+
+// The optimal step computed from cached per-sample losses matches the one computed from
+// weights and responses
+TEST_F(ExponentialLossTest, OptimalStepFromSampleLosses) {
+    Dataset dataset;
+    std::vector<double> weights, responses;
+    std::vector<int> direction;
+    for (int i = 0; i < 20; i++) {
+        DataInstance sample(1, static_cast<double>(i));
+        dataset.add(sample, (i % 3 == 0) ? 1 : -1);
+        weights.push_back(0.5 + 0.1 * i);
+        responses.push_back(0.3 * (i % 5) - 0.6);
+        direction.push_back((i % 4 == 0) ? 0 : ((i % 2 == 0) ? 1 : -1));
+    }
+
+    // the same exponentials as optimal_step_along_direction
+    std::vector<double> sample_losses(dataset.size());
+    loss->setSimdLevel(SIMD_SCALAR);
+    loss->value(dataset, weights, responses, sample_losses);
+
+    double step, minimum_loss, cached_step, cached_minimum_loss;
+    loss->optimal_step_along_direction(dataset, weights, responses, direction, &step, &minimum_loss);
+    loss->optimal_step_along_direction(dataset, sample_losses, direction, &cached_step, &cached_minimum_loss);
+
+    EXPECT_EQ(cached_step, step);
+    EXPECT_EQ(cached_minimum_loss, minimum_loss);
+}
+
+// Distance in ulps between two finite doubles of the same sign
+static int64_t UlpDistance(double a, double b) {
+    int64_t a_bits, b_bits;
+    std::memcpy(&a_bits, &a, sizeof(a));
+    std::memcpy(&b_bits, &b, sizeof(b));
+    return a_bits > b_bits ? a_bits - b_bits : b_bits - a_bits;
+}
+
+// The vector exp is within one ulp of std::exp, which the scalar kernels use: with unit weights
+// the losses are the exponentials themselves
+TEST_F(ExponentialLossTest, VectorExpWithinOneUlp) {
+    Dataset dataset;
+    std::vector<double> weights, responses;
+    for (int i = 0; i < 20000; i++) {
+        DataInstance sample(1, 0.0);
+        dataset.add(sample, (i % 2 == 0) ? 1 : -1);
+        weights.push_back(1.0);
+        responses.push_back(0.0353 * (i - 10000) + 1e-5 * (i % 7));
+    }
+
+    std::vector<double> values(dataset.size());
+    loss->setSimdLevel(SIMD_SCALAR);
+    loss->value(dataset, weights, responses, values);
+
+    SimdLevel levels[] = {SIMD_AVX2, SIMD_AVX512};
+    for (int l = 0; l < 2; l++) {
+        std::vector<double> simd_values(dataset.size());
+        loss->setSimdLevel(levels[l]);
+        loss->value(dataset, weights, responses, simd_values);
+        for (size_t i = 0; i < dataset.size(); i++)
+            EXPECT_LE(UlpDistance(simd_values[i], values[i]), 1) << "response " << responses[i];
+    }
+}
+
+// The vector kernels of value and gradient are within two ulps of the scalar ones (the exp, and
+// the rounding of the product by the weight), and fall back to std::exp for arguments out of
+// their range
+TEST_F(ExponentialLossTest, VectorKernelsMatchScalar) {
+    Dataset dataset;
+    std::vector<double> weights, responses;
+    for (int i = 0; i < 1003; i++) {
+        DataInstance sample(1, 0.0);
+        dataset.add(sample, (i % 3 == 0) ? 1 : -1);
+        weights.push_back(0.25 + 0.001 * i);
+        responses.push_back(0.7 * (i - 500));
+    }
+    responses[10] = 800.0;
+    responses[11] = -800.0;
+
+    std::vector<double> values(dataset.size()), gradient(dataset.size());
+    loss->setSimdLevel(SIMD_SCALAR);
+    loss->value(dataset, weights, responses, values);
+    loss->gradient(dataset, weights, responses, gradient);
+
+    SimdLevel levels[] = {SIMD_AVX2, SIMD_AVX512};
+    for (int l = 0; l < 2; l++) {
+        std::vector<double> simd_values(dataset.size()), simd_gradient(dataset.size());
+        loss->setSimdLevel(levels[l]);
+        loss->value(dataset, weights, responses, simd_values);
+        loss->gradient(dataset, weights, responses, simd_gradient);
+
+        for (size_t i = 0; i < dataset.size(); i++) {
+            if (std::isfinite(values[i])) {
+                EXPECT_NEAR(simd_values[i], values[i], 4.5e-16 * values[i]);
+                EXPECT_NEAR(simd_gradient[i], gradient[i], 4.5e-16 * std::fabs(gradient[i]));
+            }
+        }
+        EXPECT_EQ(simd_values[10], values[10]);
+        EXPECT_EQ(simd_values[11], values[11]);
+        EXPECT_EQ(simd_gradient[10], gradient[10]);
+    }
+}
+
+// The step from packed labels and directions matches the one from the dataset, at every level
+TEST_F(ExponentialLossTest, PackedOptimalStep) {
+    Dataset dataset;
+    std::vector<double> sample_losses;
+    std::vector<int> direction;
+    std::vector<int8_t> packed_labels, packed_direction;
+    for (int i = 0; i < 1003; i++) {
+        DataInstance sample(1, 0.0);
+        int label = (i % 3 == 0) ? 1 : -1;
+        dataset.add(sample, label);
+        sample_losses.push_back(0.5 + 0.01 * (i % 17));
+        direction.push_back((i % 7) % 3 - 1);
+        packed_labels.push_back(label);
+        packed_direction.push_back(direction.back());
+    }
+
+    double step, minimum_loss;
+    loss->optimal_step_along_direction(dataset, sample_losses, direction, &step, &minimum_loss);
+
+    SimdLevel levels[] = {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512};
+    for (int l = 0; l < 3; l++) {
+        double packed_step, packed_minimum_loss;
+        loss->setSimdLevel(levels[l]);
+        loss->optimal_step_along_direction(packed_labels, sample_losses, packed_direction,
+                                           &packed_step, &packed_minimum_loss);
+
+        EXPECT_NEAR(packed_step, step, 1e-14);
+        EXPECT_NEAR(packed_minimum_loss, minimum_loss, 1e-12);
+    }
+}
+
+// Weight sums are compensated: many losses far below the rounding error of the sum still count
+TEST_F(ExponentialLossTest, CompensatedWeightSums) {
+    const int n = 1 << 20;
+    std::vector<double> sample_losses(n, 1e-16);
+    std::vector<int8_t> labels(n, 1), direction(n, 0);
+    sample_losses[0] = 1.0;
+
+    SimdLevel levels[] = {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512};
+    for (int l = 0; l < 3; l++) {
+        double step, minimum_loss;
+        loss->setSimdLevel(levels[l]);
+        loss->optimal_step_along_direction(labels, sample_losses, direction, &step, &minimum_loss);
+
+        EXPECT_NEAR(minimum_loss, 1.0 + (n - 1) * 1e-16, 1e-15);
+    }
+}
+
+// Labels other than -1, 0 and 1 are rejected, and packed agreements outside the three buckets
+// are dropped alike by all the kernels
+TEST_F(ExponentialLossTest, InvalidLabels) {
+    Dataset dataset;
+    DataInstance sample(1, 0.0);
+    dataset.add(sample, 1);
+    dataset.add(sample, 2);
+
+    std::vector<double> weights(2, 1.0), responses(2, 0.0), out(2);
+    std::vector<int> direction(2, 1);
+    double step, minimum_loss;
+    EXPECT_THROW(loss->value(dataset, weights, responses, out), std::invalid_argument);
+    EXPECT_THROW(loss->gradient(dataset, weights, responses, out), std::invalid_argument);
+    EXPECT_THROW(loss->optimal_step_along_direction(dataset, weights, direction, &step, &minimum_loss),
+                 std::invalid_argument);
+
+    std::vector<double> sample_losses;
+    std::vector<int8_t> labels, packed_direction;
+    for (int i = 0; i < 100; i++) {
+        sample_losses.push_back(1.0 + i);
+        labels.push_back((i % 5 == 0) ? 3 : (i % 2 == 0 ? 1 : -1));
+        packed_direction.push_back((i % 7 == 0) ? 2 : (i % 3 == 0 ? -1 : 1));
+    }
+
+    double expected_step, expected_minimum_loss;
+    loss->setSimdLevel(SIMD_SCALAR);
+    loss->optimal_step_along_direction(labels, sample_losses, packed_direction,
+                                       &expected_step, &expected_minimum_loss);
+
+    SimdLevel levels[] = {SIMD_AVX2, SIMD_AVX512};
+    for (int l = 0; l < 2; l++) {
+        loss->setSimdLevel(levels[l]);
+        loss->optimal_step_along_direction(labels, sample_losses, packed_direction, &step, &minimum_loss);
+        EXPECT_NEAR(step, expected_step, 1e-14);
+        EXPECT_NEAR(minimum_loss, expected_minimum_loss, 1e-12);
+    }
+}
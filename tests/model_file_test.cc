@@ -0,0 +1,243 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdint.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "src/boosted_classifier.h"
+#include "src/classifier_factory.h"
+#include "src/dataset.h"
+#include "src/gaussian_learner.h"
+#include "src/gaussian_mixture_model.h"
+#include "src/model_file.h"
+#include "src/naive_bayes_classifier.h"
+#include "src/stump_ensemble.h"
+#include "src/threshold_learner.h"
+#include "tests/test_datasets.h"
+
+// Return the path of a new empty temporary file.
+static std::string TempPath() {
+    char path[] = "/tmp/lakeml_model_test_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_GE(fd, 0);
+    close(fd);
+    return std::string(path);
+}
+
+// Factory alternating threshold and gaussian learners over the features
+class MixedLearnerFactory : public ClassifierFactory {
+public:
+    MixedLearnerFactory() : draws(0) {}
+
+    Classifier* createRandomInstance() const override {
+        int draw = draws++;
+        if (draw % 2 == 0)
+            return new ThresholdLearner(draw % 3);
+        return new GaussianLearner(draw % 3);
+    }
+
+private:
+    mutable int draws;
+};
+
+// A loaded boosted classifier responds like the saved one, soft cascade included
+TEST(ModelFileTest, BoostedClassifierRoundTrip) {
+    Dataset dataset = MakeSineDataset(300);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier saved(20);
+    saved.train(dataset, weights);
+    saved.calibrateSoftCascade(dataset);
+
+    std::string path = TempPath();
+    SaveModel(saved, path);
+
+    BoostedClassifier loaded;
+    LoadModel(path, &loaded);
+    std::remove(path.c_str());
+
+    ASSERT_EQ(loaded.getNumWeakLearners(), saved.getNumWeakLearners());
+    EXPECT_TRUE(loaded.hasSoftCascade());
+    for (size_t i = 0; i < dataset.size(); i++) {
+        int saved_evaluated, loaded_evaluated;
+        EXPECT_EQ(loaded.response(dataset[i]), saved.response(dataset[i]));
+        EXPECT_EQ(loaded.classify(dataset[i], &loaded_evaluated), saved.classify(dataset[i], &saved_evaluated));
+        EXPECT_EQ(loaded_evaluated, saved_evaluated);
+    }
+}
+
+// A stump ensemble mapped from a model file scores like the compiled classifier
+TEST(ModelFileTest, MappedStumpEnsemble) {
+    Dataset dataset = MakeSineDataset(300);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier boosted(20);
+    boosted.train(dataset, weights);
+    StumpEnsemble compiled(boosted);
+
+    std::string path = TempPath();
+    SaveModel(boosted, path);
+    StumpEnsemble mapped = LoadStumpEnsemble(path);
+    std::remove(path.c_str());  // the mapping stays valid
+
+    ASSERT_EQ(mapped.size(), compiled.size());
+    EXPECT_EQ(mapped.dimension(), compiled.dimension());
+    EXPECT_LE(mapped.dimension(), dataset.dimension());
+    std::vector<double> responses(dataset.size());
+    mapped.response(dataset, 0, dataset.size(), responses.data());
+
+    for (size_t i = 0; i < dataset.size(); i++) {
+        EXPECT_EQ(mapped.response(dataset[i]), compiled.response(dataset[i]));
+        EXPECT_EQ(responses[i], compiled.response(dataset[i]));
+        EXPECT_EQ(mapped.classify(dataset[i]), compiled.classify(dataset[i]));
+    }
+}
+
+// A loaded naive Bayes classifier keeps its threshold and gaussian weak learners
+TEST(ModelFileTest, NaiveBayesRoundTrip) {
+    Dataset dataset = MakeSineDataset(200);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    MixedLearnerFactory factory;
+    NaiveBayesClassifier saved(&factory, 6);
+    saved.train(dataset, weights);
+
+    std::string path = TempPath();
+    SaveModel(saved, path);
+
+    NaiveBayesClassifier loaded;
+    LoadModel(path, &loaded);
+    std::remove(path.c_str());
+
+    for (size_t i = 0; i < dataset.size(); i++) {
+        EXPECT_EQ(loaded.response(dataset[i]), saved.response(dataset[i]));
+        EXPECT_EQ(loaded.classify(dataset[i]), saved.classify(dataset[i]));
+    }
+}
+
+// A loaded gaussian mixture gives the same likelihoods and components
+TEST(ModelFileTest, GaussianMixtureRoundTrip) {
+    Dataset dataset;
+    for (int i = 0; i < 60; i++) {
+        DataInstance sample;
+        double center = (i % 2 == 0) ? 10.0 : -10.0;
+        sample.push_back(center + std::sin(1.7 * i));
+        sample.push_back(center + std::cos(2.3 * i));
+        dataset.add(sample, 1);
+    }
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    GaussianMixtureModel saved(2, 20);
+    saved.train(dataset, weights);
+
+    std::string path = TempPath();
+    SaveModel(saved, path);
+
+    GaussianMixtureModel loaded(1, 1);
+    LoadModel(path, &loaded);
+    std::remove(path.c_str());
+
+    for (size_t i = 0; i < dataset.size(); i++) {
+        EXPECT_EQ(loaded.response(dataset[i]), saved.response(dataset[i]));
+        EXPECT_EQ(loaded.classify(dataset[i]), saved.classify(dataset[i]));
+    }
+}
+
+// Files that are not models of the expected type are rejected
+TEST(ModelFileTest, RejectsInvalidFiles) {
+    std::string path = TempPath();
+    std::ofstream(path.c_str()) << "not a model";
+
+    BoostedClassifier boosted;
+    EXPECT_THROW(LoadModel(path, &boosted), std::runtime_error);
+    EXPECT_THROW(LoadStumpEnsemble(path), std::runtime_error);
+
+    Dataset dataset = MakeSineDataset(100);
+    std::vector<double> weights(dataset.size(), 1.0);
+    MixedLearnerFactory factory;
+    NaiveBayesClassifier naive_bayes(&factory, 2);
+    naive_bayes.train(dataset, weights);
+    SaveModel(naive_bayes, path);
+
+    EXPECT_THROW(LoadModel(path, &boosted), std::runtime_error);
+
+    // truncated file
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream(path.c_str(), std::ios::binary | std::ios::trunc) << content.substr(0, 140);
+    NaiveBayesClassifier truncated;
+    EXPECT_THROW(LoadModel(path, &truncated), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+// Overwrites the uint32 at 'index' of section 'section' of a model file
+static void PatchSection(const std::string& path, int section, int index, uint32_t value) {
+    std::fstream file(path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+    uint64_t offset;
+    file.seekg(48 + 8 * section);
+    file.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+    file.seekp(offset + 4 * index);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Stumps whose label on left is not -1 or 1, or whose feature is not below the stored
+// dimension, are rejected when loading instead of scoring wrong or past the samples
+TEST(ModelFileTest, RejectsInvalidStumps) {
+    Dataset dataset = MakeSineDataset(100);
+    std::vector<double> weights(dataset.size(), 1.0);
+    BoostedClassifier saved(5);
+    saved.train(dataset, weights);
+
+    std::string path = TempPath();
+    SaveModel(saved, path);
+    PatchSection(path, 5, 2, 3);    // label on left of stump 2
+    BoostedClassifier loaded;
+    EXPECT_THROW(LoadModel(path, &loaded), std::runtime_error);
+    EXPECT_THROW(LoadStumpEnsemble(path), std::runtime_error);
+
+    SaveModel(saved, path);
+    PatchSection(path, 0, 1, StumpEnsemble(saved).dimension());    // feature of stump 1
+    EXPECT_THROW(LoadModel(path, &loaded), std::runtime_error);
+    EXPECT_THROW(LoadStumpEnsemble(path), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+// Only boosted stumps can be saved
+TEST(ModelFileTest, RejectsOtherBoostedWeakLearners) {
+    Dataset dataset = MakeSineDataset(100);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    MixedLearnerFactory factory;  // one trial a round: the second weak learner is gaussian
+    BoostedClassifier boosted(&factory, 2, 1);
+    boosted.train(dataset, weights);
+
+    std::string path = TempPath();
+    EXPECT_THROW(SaveModel(boosted, path), std::invalid_argument);
+    std::remove(path.c_str());
+}
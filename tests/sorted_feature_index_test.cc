@@ -0,0 +1,129 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "src/dataset.h"
+#include "src/sorted_feature_index.h"
+#include "src/threshold_learner.h"
+
+// Column-major dataset of 'n' samples whose 2 features take few distinct integer values, so
+// that the index must order ties, with some missing values the index must leave out
+static Dataset MakeTiedDataset(int n) {
+    Dataset dataset(Dataset::COLUMN_MAJOR);
+    for (int i = 0; i < n; i++) {
+        DataInstance sample;
+        sample.push_back(static_cast<double>((i * 7) % 11));
+        sample.push_back(i % 5 == 0 ? std::numeric_limits<double>::quiet_NaN()
+                                    : static_cast<double>((i * 13) % 17) - 8.0);
+        dataset.add(sample, ((i * 7) % 11 > 4) != (i % 4 == 0) ? 1 : -1);
+    }
+    return dataset;
+}
+
+// Each feature lists its finite samples by increasing value, ties by increasing index
+TEST(SortedFeatureIndexTest, SortsEachFeature) {
+    Dataset dataset = MakeTiedDataset(200);
+    SortedFeatureIndex index(dataset, 3);
+
+    ASSERT_EQ(index.dimension(), dataset.dimension());
+    EXPECT_EQ(index.size(0), static_cast<size_t>(200));
+    EXPECT_EQ(index.size(1), static_cast<size_t>(160));
+
+    for (size_t d = 0; d < index.dimension(); d++) {
+        const unsigned int* indices = index.sampleIndices(d);
+        const double* values = index.sortedValues(d);
+        for (size_t i = 0; i < index.size(d); i++) {
+            EXPECT_EQ(values[i], dataset[indices[i]][d]);
+            if (i > 0) {
+                EXPECT_LE(values[i - 1], values[i]);
+                if (values[i - 1] == values[i]) {
+                    EXPECT_LT(indices[i - 1], indices[i]);
+                }
+            }
+        }
+    }
+}
+
+// The cached index is computed once and dropped when the dataset changes
+TEST(SortedFeatureIndexTest, CachedInDataset) {
+    Dataset dataset = MakeTiedDataset(50);
+    EXPECT_TRUE(dataset.sortedIndex() == nullptr);
+
+    const SortedFeatureIndex& index = CacheSortedFeatureIndex(dataset);
+    EXPECT_EQ(dataset.sortedIndex(), &index);
+    EXPECT_EQ(&CacheSortedFeatureIndex(dataset), &index);
+
+    dataset.add(dataset[0], 1);
+    EXPECT_TRUE(dataset.sortedIndex() == nullptr);
+    EXPECT_EQ(CacheSortedFeatureIndex(dataset).size(0), static_cast<size_t>(51));
+}
+
+// Threshold learners find exactly the same split with and without the index
+TEST(SortedFeatureIndexTest, ThresholdLearnerSplitUnchanged) {
+    Dataset plain = MakeTiedDataset(300);
+    Dataset indexed = plain;
+    CacheSortedFeatureIndex(indexed);
+
+    std::vector<double> weights(plain.size());
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = 1.0 + std::sin(static_cast<double>(i));
+
+    for (unsigned int d = 0; d < plain.dimension(); d++) {
+        ThresholdLearner sorting(d), presorted(d);
+        sorting.train(plain, weights);
+        presorted.train(indexed, weights);
+
+        for (size_t i = 0; i < plain.size(); i++) {
+            if (std::isfinite(plain[i][d])) {
+                EXPECT_EQ(sorting.response(plain[i]), presorted.response(plain[i]));
+            }
+            EXPECT_EQ(sorting.classify(plain[i]), presorted.classify(plain[i]));
+        }
+    }
+}
+
+// Scanning the index of a dataset, samples of zero weight are skipped: the stump is the one
+// trained on a dataset holding only the other samples
+TEST(SortedFeatureIndexTest, SkipsZeroWeights) {
+    Dataset dataset = MakeTiedDataset(200);
+    const SortedFeatureIndex& index = CacheSortedFeatureIndex(dataset, 1);
+
+    Dataset subset(Dataset::COLUMN_MAJOR);
+    std::vector<double> weights(dataset.size(), 0.0), subset_weights;
+    std::vector<int> labels(dataset.size());
+    for (size_t i = 0; i < dataset.size(); i++) {
+        labels[i] = dataset.getLabelAt(i);
+        if (i % 3 != 1) {
+            weights[i] = 1.0 + (i % 4);
+            subset.add(dataset[i], dataset.getLabelAt(i));
+            subset_weights.push_back(weights[i]);
+        }
+    }
+
+    for (unsigned int d = 0; d < dataset.dimension(); d++) {
+        ThresholdLearner scanned(d), on_subset(d);
+        scanned.train(dataset, index, labels, weights);
+        on_subset.train(subset, subset_weights);
+        EXPECT_EQ(scanned.getThreshold(), on_subset.getThreshold());
+        EXPECT_EQ(scanned.getLabelOnLeft(), on_subset.getLabelOnLeft());
+    }
+}
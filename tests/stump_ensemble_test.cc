@@ -0,0 +1,121 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+#include "src/boosted_classifier.h"
+#include "src/classifier_factory.h"
+#include "src/cpu_features.h"
+#include "src/dataset.h"
+#include "src/gaussian_learner.h"
+#include "src/stump_ensemble.h"
+#include "tests/test_datasets.h"
+
+class GaussianLearnerFactory : public ClassifierFactory {
+public:
+    Classifier* createRandomInstance() const override {
+        return new GaussianLearner(0);
+    }
+};
+
+// The compiled ensemble responds exactly like the boosted classifier
+TEST(StumpEnsembleTest, SameResponsesAsBoostedClassifier) {
+    Dataset dataset = MakeSineDataset(600);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier boosted(25);
+    boosted.train(dataset, weights);
+
+    StumpEnsemble ensemble(boosted);
+    ASSERT_EQ(ensemble.size(), static_cast<size_t>(25));
+
+    Dataset test_dataset = MakeSineDataset(900);
+    for (size_t i = 0; i < test_dataset.size(); i++) {
+        EXPECT_EQ(ensemble.response(test_dataset[i]), boosted.response(test_dataset[i]));
+        EXPECT_EQ(ensemble.classify(test_dataset[i]), boosted.classify(test_dataset[i]));
+    }
+}
+
+// An empty ensemble responds 0
+TEST(StumpEnsembleTest, Empty) {
+    StumpEnsemble ensemble;
+    DataInstance sample(3, 1.0);
+
+    EXPECT_EQ(ensemble.size(), static_cast<size_t>(0));
+    EXPECT_EQ(ensemble.response(sample), 0.0);
+    EXPECT_EQ(ensemble.classify(sample), -1);
+}
+
+// Only ensembles of threshold learners can be compiled
+TEST(StumpEnsembleTest, RejectsOtherWeakLearners) {
+    Dataset dataset = MakeSineDataset(100);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    GaussianLearnerFactory factory;
+    BoostedClassifier boosted(&factory, 2, 1);
+    boosted.train(dataset, weights);
+
+    EXPECT_THROW(StumpEnsemble ensemble(boosted), std::invalid_argument);
+}
+
+// Batch responses equal single responses with every instruction set and storage layout
+TEST(StumpEnsembleTest, BatchResponses) {
+    Dataset dataset = MakeSineDataset(700);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier boosted(30);
+    boosted.train(dataset, weights);
+    StumpEnsemble ensemble(boosted);
+
+    Dataset layouts[] = {MakeSineDataset(1000), Dataset(MakeSineDataset(1000), Dataset::COLUMN_MAJOR)};
+    SimdLevel levels[] = {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512};
+
+    for (int l = 0; l < 2; l++) {
+        const Dataset& test_dataset = layouts[l];
+        for (int s = 0; s < 3; s++) {
+            ensemble.setSimdLevel(levels[s]);
+
+            // an offset and a size that is not a multiple of the vector or block size
+            std::vector<double> responses(test_dataset.size() - 3, -1.0);
+            ensemble.response(test_dataset, 3, responses.size(), responses.data());
+
+            for (size_t i = 0; i < responses.size(); i++)
+                EXPECT_EQ(responses[i], ensemble.response(test_dataset[3 + i]));
+        }
+    }
+}
+
+// The compiled ensemble applies the soft cascade of the boosted classifier
+TEST(StumpEnsembleTest, SoftCascade) {
+    Dataset dataset = MakeSineDataset(800);
+    std::vector<double> weights(dataset.size(), 1.0);
+
+    BoostedClassifier boosted(30);
+    boosted.train(dataset, weights);
+    boosted.calibrateSoftCascade(dataset);
+    StumpEnsemble ensemble(boosted);
+
+    for (size_t i = 0; i < dataset.size(); i++) {
+        int boosted_evaluated, ensemble_evaluated;
+        EXPECT_EQ(ensemble.classify(dataset[i], &ensemble_evaluated),
+                  boosted.classify(dataset[i], &boosted_evaluated));
+        EXPECT_EQ(ensemble_evaluated, boosted_evaluated);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TESTS_TEST_DATASETS_H_
+#define TESTS_TEST_DATASETS_H_
+
+#include <cmath>
+#include <limits>
+
+#include "src/dataset.h"
+
+// Dataset of 'n' samples of 4 features for the tests comparing classifiers that should respond
+// the same (e.g. compiled or loaded from a file): feature d of sample i is a sine of frequency
+// 0.21 * (d + 1) plus a small offset cycling with i, so that there are few ties, and feature 2
+// is missing every 13 samples. The label is 1 if feature 0 plus half of feature 2 exceeds 0.3.
+inline Dataset MakeSineDataset(int n) {
+    Dataset dataset;
+    for (int i = 0; i < n; i++) {
+        DataInstance sample;
+        for (int d = 0; d < 4; d++)
+            sample.push_back(std::sin(0.21 * i * (d + 1)) + 0.05 * ((i * (d + 2)) % 11));
+        if (i % 13 == 0)
+            sample[2] = std::numeric_limits<double>::quiet_NaN();
+        dataset.add(sample, (sample[0] + 0.5 * sample[2] > 0.3) ? 1 : -1);
+    }
+    return dataset;
+}
+
+#endif  // TESTS_TEST_DATASETS_H_
@@ -0,0 +1,71 @@
+/*
+ *   Copyright 2008-2012 Hugo Penedones
+ *
+ *   This file is part of lakeml.
+ *
+ *   lakeml is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   lakeml is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with lakeml.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+#include "src/thread_pool.h"
+
+// Every index is processed exactly once, by a valid worker
+TEST(ThreadPoolTest, RunsEveryTaskOnce) {
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+
+    std::vector<int> calls(1000, 0);
+    std::vector<int> bad_worker(1000, 0);
+    pool.run(calls.size(), [&](size_t index, int worker) {
+        calls[index]++;
+        bad_worker[index] = (worker < 0 || worker >= 4);
+    });
+
+    for (size_t i = 0; i < calls.size(); i++) {
+        EXPECT_EQ(calls[i], 1);
+        EXPECT_EQ(bad_worker[i], 0);
+    }
+}
+
+// The pool can be reused for many consecutive loops
+TEST(ThreadPoolTest, Reuse) {
+    ThreadPool pool(3);
+    std::vector<long> sums(pool.size(), 0);
+
+    for (int round = 0; round < 200; round++)
+        pool.run(50, [&](size_t index, int worker) { sums[worker] += index; });
+
+    long total = 0;
+    for (size_t w = 0; w < sums.size(); w++)
+        total += sums[w];
+    EXPECT_EQ(total, 200L * (49 * 50 / 2));
+}
+
+// An exception thrown by a task is rethrown by run()
+TEST(ThreadPoolTest, PropagatesExceptions) {
+    ThreadPool pool(2);
+    EXPECT_THROW(pool.run(100,
+                          [](size_t index, int) {
+                              if (index == 42)
+                                  throw std::runtime_error("task failed");
+                          }),
+                 std::runtime_error);
+
+    // and the pool is still usable afterwards
+    int count = 0;
+    pool.run(1, [&](size_t, int) { count++; });
+    EXPECT_EQ(count, 1);
+}
@@ -181,3 +181,22 @@ TEST_F(ThresholdLearnerTest, PerfectlySeparableData) {
     EXPECT_TRUE(class_neg == -1 || class_neg == 1);
     EXPECT_TRUE(class_pos == -1 || class_pos == 1);
 }
+
+// Test histogram split search on perfectly separable data
+TEST(ThresholdLearnerHistogramTest, PerfectlySeparableData) {
+    Dataset training_dataset;
+
+    for (int i = 0; i < 100; i++) {
+        DataInstance sample;
+        sample.push_back(static_cast<double>(i));
+        training_dataset.add(sample, (i < 40) ? -1 : 1);
+    }
+
+    std::vector<double> weights(100, 1.0);
+    ThresholdLearner histogram_learner(0, ThresholdLearner::HISTOGRAM);
+    histogram_learner.train(training_dataset, weights);
+
+    EXPECT_DOUBLE_EQ(histogram_learner.getThreshold(), 40.0);
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(histogram_learner.classify(training_dataset[i]), training_dataset.getLabelAt(i));
+}